@@ -2,16 +2,37 @@
 // Written by Michael Simkin 2015
 #include "LifeAPI.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
 #include <ctime>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <array>
 #include <algorithm>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 const int MAX_CATALYSTS = 5;
 
@@ -69,6 +90,13 @@ public:
   int stopAfterCatsDestroyed;
   int maxJunk;
 
+  unsigned numThreads;
+
+  std::string checkpointFile;
+  unsigned checkpointInterval;
+
+  int boardSize;
+
   SearchParams() {
     maxGen = 250;
     numCatalysts = 2;
@@ -94,6 +122,10 @@ public:
     alsoRequiredXY = {0, 0};
     stopAfterCatsDestroyed = -1;
     maxJunk = -1;
+    numThreads = 1;
+    checkpointFile = "";
+    checkpointInterval = 60;
+    boardSize = 64;
   }
 };
 
@@ -308,39 +340,50 @@ inline std::vector<SymmetryTransform> SymmetryChainFromEnum(const StaticSymmetry
   }
 }
 
-LifeState FundamentalDomain(const StaticSymmetry sym) {
+// The cells (x, y) with 0 <= x, y < N, as the torus stores them, from
+// which the symmetry generates the whole torus
+inline bool InFundamentalDomain(const StaticSymmetry sym, int x, int y, int n) {
   switch (sym) {
   case StaticSymmetry::C1:
-    return LifeState::Parse("64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o!");
+    return true;
   case StaticSymmetry::D2AcrossY:
   case StaticSymmetry::D2AcrossYEven:
-    return LifeState::Parse("32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o!");
+    return x < n / 2;
   case StaticSymmetry::D2AcrossX:
   case StaticSymmetry::D2AcrossXEven:
-    return LifeState::Parse("64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o!");
-  case StaticSymmetry::D2diagodd:
-    return LifeState::Parse("64o$63o$62o$61o$60o$59o$58o$57o$56o$55o$54o$53o$52o$51o$50o$49o$48o$47o$46o$45o$44o$43o$42o$41o$40o$39o$38o$37o$36o$35o$34o$33o$32o$31o$30o$29o$28o$27o$26o$25o$24o$23o$22o$21o$20o$19o$18o$17o$16o$15o$14o$13o$12o$11o$10o$9o$8o$7o$6o$5o$4o$3o$2o$o!");
-  case StaticSymmetry::D2negdiagodd:
-    return LifeState::Parse("o$2o$3o$4o$5o$6o$7o$8o$9o$10o$11o$12o$13o$14o$15o$16o$17o$18o$19o$20o$21o$22o$23o$24o$25o$26o$27o$28o$29o$30o$31o$32o$33o$34o$35o$36o$37o$38o$39o$40o$41o$42o$43o$44o$45o$46o$47o$48o$49o$50o$51o$52o$53o$54o$55o$56o$57o$58o$59o$60o$61o$62o$63o$64o!");
   case StaticSymmetry::C2:
   case StaticSymmetry::C2even:
   case StaticSymmetry::C2horizontaleven:
   case StaticSymmetry::C2verticaleven:
-    return LifeState::Parse("64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o$64o!");
+    return y < n / 2;
+  case StaticSymmetry::D2diagodd:
+    return x + y < n;
+  case StaticSymmetry::D2negdiagodd:
+    return x <= y;
   case StaticSymmetry::C4:
   case StaticSymmetry::C4even:
   case StaticSymmetry::D4:
   case StaticSymmetry::D4even:
   case StaticSymmetry::D4horizontaleven:
   case StaticSymmetry::D4verticaleven:
-    return LifeState::Parse("32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o$32o!");
+    return x < n / 2 && y < n / 2;
   case StaticSymmetry::D4diag:
   case StaticSymmetry::D4diageven:
-    return LifeState::Parse("o$2o$3o$4o$5o$6o$7o$8o$9o$10o$11o$12o$13o$14o$15o$16o$17o$18o$19o$20o$21o$22o$23o$24o$25o$26o$27o$28o$29o$30o$31o$32o$32o$31o$30o$29o$28o$27o$26o$25o$24o$23o$22o$21o$20o$19o$18o$17o$16o$15o$14o$13o$12o$11o$10o$9o$8o$7o$6o$5o$4o$3o$2o$o!");
+    return x <= y && x + y < n;
   case StaticSymmetry::D8:
   case StaticSymmetry::D8even:
-    return LifeState::Parse("o$2o$3o$4o$5o$6o$7o$8o$9o$10o$11o$12o$13o$14o$15o$16o$17o$18o$19o$20o$21o$22o$23o$24o$25o$26o$27o$28o$29o$30o$31o$32o!");
+    return x <= y && y < n / 2;
   }
+  return true;
+}
+
+template <int N> LifeState<N> FundamentalDomain(const StaticSymmetry sym) {
+  LifeState<N> result;
+  for (int x = 0; x < N; x++)
+    for (int y = 0; y < N; y++)
+      if (InFundamentalDomain(sym, x, y, N))
+        result.Set(x, y);
+  return result;
 }
 
 inline std::pair<int, int> CommuteTranslation(const SymmetryTransform sym, std::pair<int, int> vec) {
@@ -485,6 +528,10 @@ void ReadParams(const std::string& fname, std::vector<CatalystInput> &catalysts,
   std::string alsoRequired = "also-required";
   std::string stopAfterCatsDestroyed = "stop-after-cats-destroyed";
   std::string maxJunk = "max-junk";
+  std::string threads = "threads";
+  std::string checkpoint = "checkpoint";
+  std::string checkpointInterval = "checkpoint-interval";
+  std::string boardSize = "board-size";
 
   std::string line;
 
@@ -607,6 +654,18 @@ void ReadParams(const std::string& fname, std::vector<CatalystInput> &catalysts,
       params.stopAfterCatsDestroyed = atoi(elems[1].c_str());
     } else if (elems[0] == maxJunk){
       params.maxJunk = atoi(elems[1].c_str());
+    } else if (elems[0] == threads) {
+      params.numThreads = std::max(1, atoi(elems[1].c_str()));
+    } else if (elems[0] == checkpoint) {
+      params.checkpointFile = elems[1];
+    } else if (elems[0] == checkpointInterval) {
+      params.checkpointInterval = std::max(1, atoi(elems[1].c_str()));
+    } else if (elems[0] == boardSize) {
+      params.boardSize = atoi(elems[1].c_str());
+      if (params.boardSize != 32 && params.boardSize != 64 && params.boardSize != 128) {
+        std::cout << "Unsupported board size " << elems[1] << ", expected 32, 64 or 128" << std::endl;
+        exit(1);
+      }
     } else {
       if(std::isalpha(elems[0][0])) {
         std::cout << "Unknown input parameter: " << elems[0] << std::endl;
@@ -632,48 +691,83 @@ void ReadParams(const std::string& fname, std::vector<CatalystInput> &catalysts,
   }
 }
 
-class CatalystData {
+template <int N> class CatalystData {
 public:
-  LifeState state;
-  LifeTarget target;
-  LifeState reactionMask;
+  LifeState<N> state;
+  LifeTarget<N> target;
+  LifeState<N> reactionMask;
   unsigned maxDisappear;
-  std::vector<LifeTarget> forbidden;
-  LifeState required;
-  LifeState antirequired;
+  std::vector<LifeTarget<N>> forbidden;
+  LifeState<N> required;
+  LifeState<N> antirequired;
   bool hasLocus;
-  LifeState locus;
-  LifeState locusReactionMask;
-  LifeState locusAvoidMask;
+  LifeState<N> locus;
+  LifeState<N> locusReactionMask;
+  LifeState<N> locusAvoidMask;
+  // The masks above prepared for Convolve
+  LifeKernel<N> reactionKernel;
+  LifeKernel<N> locusReactionKernel;
+  LifeKernel<N> locusAvoidKernel;
   bool transparent;
   bool mustInclude;
   bool checkRecovery;
   bool sacrificial;
 
-  static std::vector<CatalystData> FromInput(CatalystInput &input);
+  static std::vector<CatalystData<N>> FromInput(CatalystInput &input);
+
+  // Whether other is this catalyst moved, with everything attached to
+  // it moved along
+  bool SameUpToTranslation(const CatalystData<N> &other) const;
 };
 
-std::vector<CatalystData> CatalystData::FromInput(CatalystInput &input) {
+template <int N>
+bool CatalystData<N>::SameUpToTranslation(const CatalystData<N> &other) const {
+  std::array<int, 4> bounds = state.XYBounds();
+  std::array<int, 4> otherBounds = other.state.XYBounds();
+  int dx = bounds[0] - otherBounds[0];
+  int dy = bounds[1] - otherBounds[1];
+
+  auto same = [dx, dy](const LifeState<N> &a, const LifeState<N> &b) {
+    LifeState<N> moved = b;
+    moved.Move(dx, dy);
+    return moved == a;
+  };
+
+  if (!same(state, other.state) || !same(required, other.required) ||
+      !same(antirequired, other.antirequired) || !same(locus, other.locus) ||
+      forbidden.size() != other.forbidden.size())
+    return false;
+
+  for (unsigned i = 0; i < forbidden.size(); i++)
+    if (!same(forbidden[i].wanted, other.forbidden[i].wanted) ||
+        !same(forbidden[i].unwanted, other.forbidden[i].unwanted))
+      return false;
+
+  return true;
+}
+
+template <int N>
+std::vector<CatalystData<N>> CatalystData<N>::FromInput(CatalystInput &input) {
   std::vector<SymmetryTransform> trans = CharToTransforms(input.symmType);
 
   const char *rle = input.rle.c_str();
 
-  std::vector<CatalystData> results;
+  std::vector<CatalystData<N>> results;
 
   for (auto &tran : trans) {
-    LifeState pat = LifeState::Parse(rle, input.centerX, input.centerY, tran);
+    LifeState<N> pat = LifeState<N>::Parse(rle, input.centerX, input.centerY, tran);
 
-    CatalystData result;
+    CatalystData<N> result;
 
     result.state = pat;
-    result.target = LifeTarget(pat);
+    result.target = LifeTarget<N>(pat);
     result.reactionMask = pat.BigZOI();
     result.reactionMask.Transform(Rotate180OddBoth);
     result.reactionMask.RecalculateMinMax();
 
     if (input.locusRLE != "") {
       result.hasLocus = true;
-      result.locus = LifeState::Parse(input.locusRLE.c_str(),
+      result.locus = LifeState<N>::Parse(input.locusRLE.c_str(),
                                       input.locusXY.first,
                                       input.locusXY.second, tran);
     } else {
@@ -688,22 +782,26 @@ std::vector<CatalystData> CatalystData::FromInput(CatalystInput &input) {
     result.locusAvoidMask = result.reactionMask & ~result.locusReactionMask;
     result.locusAvoidMask.RecalculateMinMax();
 
+    result.reactionKernel = LifeKernel<N>(result.reactionMask);
+    result.locusReactionKernel = LifeKernel<N>(result.locusReactionMask);
+    result.locusAvoidKernel = LifeKernel<N>(result.locusAvoidMask);
+
     result.maxDisappear = input.maxDisappear;
 
     for (unsigned k = 0; k < input.forbiddenRLE.size(); k++) {
-      result.forbidden.push_back(LifeTarget::Parse(input.forbiddenRLE[k].c_str(),
+      result.forbidden.push_back(LifeTarget<N>::Parse(input.forbiddenRLE[k].c_str(),
                                                    input.forbiddenXY[k].first,
                                                    input.forbiddenXY[k].second, tran));
     }
 
     if (input.requiredRLE != "") {
-      result.required = LifeState::Parse(input.requiredRLE.c_str(),
+      result.required = LifeState<N>::Parse(input.requiredRLE.c_str(),
                                          input.requiredXY.first,
                                          input.requiredXY.second, tran);
     }
 
     if (input.antirequiredRLE != "") {
-      result.antirequired = LifeState::Parse(input.antirequiredRLE.c_str(),
+      result.antirequired = LifeState<N>::Parse(input.antirequiredRLE.c_str(),
                                              input.antirequiredXY.first,
                                              input.antirequiredXY.second, tran);
     }
@@ -713,30 +811,89 @@ std::vector<CatalystData> CatalystData::FromInput(CatalystInput &input) {
     result.checkRecovery = input.checkRecovery;
     result.sacrificial = input.sacrificial;
 
-    results.push_back(result);
+    // A symmetric catalyst can look the same after some of the
+    // transformations, and each copy would only repeat the search
+    bool duplicate = false;
+    for (auto &earlier : results)
+      duplicate = duplicate || earlier.SameUpToTranslation(result);
+    if (!duplicate)
+      results.push_back(result);
   }
   return results;
 }
 
-struct Configuration {
+template <int N> struct Configuration {
   unsigned count;
   unsigned transparentCount;
   unsigned mustIncludeCount;
   std::array<int, MAX_CATALYSTS> curx;
   std::array<int, MAX_CATALYSTS> cury;
   std::array<int, MAX_CATALYSTS> curs;
-  LifeState state;
-  LifeState startingCatalysts;
+  // Which first-catalyst placement this configuration descends from, in
+  // the order the depth-0 loop visits them (see BranchKey)
+  uint64_t branch;
+  // The BranchKey of the placement at every depth. A single-threaded
+  // search finds results in the order of their paths.
+  std::array<uint64_t, MAX_CATALYSTS> path{};
+  LifeState<N> state;
+  LifeState<N> startingCatalysts;
+  // Forbidden pattern forbiddenIndex of placed catalyst forbiddenCatalyst
+  // matched before the last catalyst was placed. Every solution below is
+  // rejected by HasForbidden, unless a later catalyst covers one of the
+  // unwanted cells of that match. -1 if there is no such match.
+  int forbiddenCatalyst{-1};
+  unsigned forbiddenIndex{};
 };
 
+inline uint64_t BranchKey(unsigned gen, unsigned s, int x, int y) {
+  return ((uint64_t)gen << 32) | ((uint64_t)s << 16) | ((uint64_t)x << 8) | (uint64_t)y;
+}
+
 // Fix a, what positions of b causes a collision?
-LifeState CollisionMask(const LifeState &a, const LifeState &b) {
+template <int N>
+LifeState<N> CollisionMask(const LifeState<N> &a, const LifeState<N> &b) {
   unsigned popsum = a.GetPop() + b.GetPop();
 
-  LifeState mask;
+  // Only offsets that bring b within distance 2 of a can interact. At
+  // any other offset the two evolve independently, so they survive
+  // together exactly when each is stable by itself.
+  LifeState<N> flipped = b;
+  flipped.Transform(Rotate180OddBoth);
+  flipped.RecalculateMinMax();
+  LifeState<N> near = a.ZOI().ZOI().Convolve(LifeKernel<N>(flipped));
+
+  LifeState<N> stepA = a;
+  stepA.Step();
+  LifeState<N> stepB = b;
+  stepB.Step();
+  bool farCollides = stepA != a || stepB != b;
+
+  // The nearby offsets are stepped a batch at a time. Without overlaps
+  // the pair survives when one step leaves the board unchanged.
+  LifeState<N> mask;
+  LifeStateBatch<N> batch;
+  std::array<LifeState<N>, LifeStateBatch<N>::Lanes> joined;
+  std::array<std::pair<int, int>, LifeStateBatch<N>::Lanes> offsets;
+  int size = 0;
+
+  auto flush = [&]() {
+    batch.Step();
+    for (int lane = 0; lane < size; lane++)
+      if (!batch.Equals(lane, joined[lane]))
+        mask.Set(offsets[lane].first, offsets[lane].second);
+    batch = LifeStateBatch<N>();
+    size = 0;
+  };
+
   for (unsigned x = 0; x < N; x++) {
-    for (unsigned y = 0; y < 64; y++) {
-      LifeState state = a;
+    for (unsigned y = 0; y < N; y++) {
+      if (!near.GetCell(x, y)) {
+        if (farCollides)
+          mask.Set(x, y);
+        continue;
+      }
+
+      LifeState<N> state = a;
       state.Join(b, x, y);
 
       // No overlaps allowed
@@ -745,126 +902,371 @@ LifeState CollisionMask(const LifeState &a, const LifeState &b) {
         continue;
       }
 
-      state.Step();
-
-      if (!state.Contains(a) || !state.Contains(b, x, y) || state.GetPop() != popsum) {
-        mask.Set(x, y);
-      }
-
+      batch.Set(size, state);
+      joined[size] = state;
+      offsets[size] = std::make_pair(x, y);
+      size++;
+      if (size == LifeStateBatch<N>::Lanes)
+        flush();
     }
   }
+  if (size > 0)
+    flush();
 
   return mask;
 }
 
-LifeState LoadCollisionMask(const CatalystData &a, const CatalystData &b) {
-  std::stringstream ss;
-  ss << "masks/maskraw-" << a.state.GetHash() << "-" << b.state.GetHash();
-  std::string fname = ss.str();
+// splitmix64 finalizer
+inline uint64_t Mix64(uint64_t h) {
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
 
-  std::ifstream infile;
-  infile.open(fname.c_str(), std::ios::binary);
-  if (!infile.good()) {
-    LifeState mask = CollisionMask(a.state, b.state);
-    std::ofstream outfile;
-    outfile.open(fname.c_str(), std::ofstream::binary);
-    outfile.write((char *)mask.state, N * sizeof(uint64_t));
-    outfile.close();
-    return mask;
-  } else {
-    LifeState result;
-    infile.read((char*)result.state, N * sizeof(uint64_t));
-    return result;
+uint64_t HashBytes(const void *bytes, size_t length, uint64_t seed = 0) {
+  const unsigned char *p = static_cast<const unsigned char *>(bytes);
+  uint64_t h = Mix64(seed ^ length);
+  for (size_t i = 0; i < length; i += 8) {
+    uint64_t chunk = 0;
+    memcpy(&chunk, p + i, std::min<size_t>(8, length - i));
+    h = Mix64(h ^ chunk) + 0x9e3779b97f4a7c15ULL;
   }
+  return Mix64(h);
 }
 
-std::string GetRLE(const std::vector<std::vector<bool>> &life2d) {
-  if (life2d.empty())
-    return "";
-
-  if (life2d[0].empty())
-    return "";
+// A catalyst as the mask cache sees it: its cells, as x y byte pairs,
+// after moving its bounding box to (0, 0), and the offset that removed.
+// The collision mask of two catalysts is that of their canonical forms
+// moved by the difference of their offsets.
+template <int N> struct CanonicalCatalyst {
+  int dx;
+  int dy;
+  std::vector<uint8_t> cells;
+
+  explicit CanonicalCatalyst(const LifeState<N> &state) : dx(N), dy(N) {
+    std::vector<std::pair<int, int>> live;
+    for (int x = -N / 2; x < N / 2; x++) {
+      for (int y = -N / 2; y < N / 2; y++) {
+        if (state.GetCell(x, y)) {
+          live.push_back(std::make_pair(x, y));
+          dx = std::min(dx, x);
+          dy = std::min(dy, y);
+        }
+      }
+    }
+    for (auto &cell : live) {
+      cells.push_back(cell.first - dx);
+      cells.push_back(cell.second - dy);
+    }
+  }
+};
 
-  std::stringstream result;
+bool MakeDirectories(const std::string &path) {
+  for (std::string::size_type slash = path.find('/', 1);; slash = path.find('/', slash + 1)) {
+    std::string prefix = path.substr(0, slash);
+    if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+      return false;
+    if (slash == std::string::npos)
+      return true;
+  }
+}
 
-  unsigned eol_count = 0;
+// $CATFORCE_MASK_CACHE, or else catforce in the user's cache directory
+std::string MaskCacheDirectory() {
+  const char *dir = getenv("CATFORCE_MASK_CACHE");
+  if (dir != nullptr && dir[0] != '\0')
+    return dir;
+  dir = getenv("XDG_CACHE_HOME");
+  if (dir != nullptr && dir[0] != '\0')
+    return std::string(dir) + "/catforce";
+  dir = getenv("HOME");
+  if (dir != nullptr && dir[0] != '\0')
+    return std::string(dir) + "/.cache/catforce";
+  return ".catforce-cache";
+}
 
-  for (unsigned j = 0; j < life2d[0].size(); j++) {
-    bool last_val = life2d[0][j];
-    unsigned run_count = 0;
+// Collision masks shared between every search on a machine: one
+// append-only file of records, each holding the canonical forms of two
+// catalysts and the mask of the pair. A record carries its length and
+// a checksum, so one torn by a crash is never read, and the next writer
+// cuts it off. Readers index the file under a shared lock and writers
+// append under an exclusive one, so any number of searches and shards
+// can fill the cache at once. Records are only ever added, which makes
+// an indexed record safe to read later without the lock.
+template <int N> class MaskCache {
+public:
+  typedef typename LifeState<N>::Word Word;
 
-    for (const auto & i : life2d) {
-      bool val = i[j];
+  MaskCache() : fd(-1), writable(false), validEnd(0) {}
 
-      // Flush linefeeds if we find a live cell
-      if (val && eol_count > 0) {
-        if (eol_count > 1)
-          result << eol_count;
+  ~MaskCache() {
+    if (fd >= 0)
+      close(fd);
+  }
 
-        result << "$";
+  MaskCache(const MaskCache &) = delete;
+  MaskCache &operator=(const MaskCache &) = delete;
 
-        eol_count = 0;
-      }
+  bool Open(const std::string &fnameIn) {
+    fname = fnameIn;
+    fd = open(fname.c_str(), O_RDWR | O_CREAT, 0644);
+    writable = fd >= 0;
+    if (fd < 0)
+      fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
 
-      // Flush current run if val changes
-      if (val == !last_val) {
-        if (run_count > 1)
-          result << run_count;
+    flock(fd, writable ? LOCK_EX : LOCK_SH);
+    char magic[sizeof(Magic)];
+    ssize_t got = pread(fd, magic, sizeof(magic), 0);
+    bool ok;
+    if (got == 0 && writable)
+      ok = pwrite(fd, Magic, sizeof(Magic), 0) == sizeof(Magic);
+    else
+      ok = got == sizeof(magic) && memcmp(magic, Magic, sizeof(magic)) == 0;
+    if (ok)
+      validEnd = Scan(sizeof(Magic));
+    flock(fd, LOCK_UN);
+
+    if (!ok) {
+      close(fd);
+      fd = -1;
+    }
+    return ok;
+  }
 
-        if (last_val == 1)
-          result << "o";
-        else
-          result << "b";
+  bool Lookup(const CanonicalCatalyst<N> &a, const CanonicalCatalyst<N> &b,
+              LifeState<N> &mask) const {
+    auto range = index.equal_range(Key(a, b));
+    for (auto it = range.first; it != range.second; ++it) {
+      std::string payload;
+      if (!ReadRecord(it->second, payload))
+        continue;
 
-        run_count = 0;
-      }
+      Fields fields;
+      memcpy(&fields, payload.data(), sizeof(fields));
+      const char *cells = payload.data() + sizeof(fields);
+      if (fields.cellsA != a.cells.size() || fields.cellsB != b.cells.size() ||
+          memcmp(cells, a.cells.data(), a.cells.size()) != 0 ||
+          memcmp(cells + a.cells.size(), b.cells.data(), b.cells.size()) != 0)
+        continue;
 
-      run_count++;
-      last_val = val;
+      const char *columns = cells + a.cells.size() + b.cells.size();
+      mask = LifeState<N>();
+      for (int k = 0; k < fields.width; k++)
+        memcpy(&mask.state[(fields.min + k) % N], columns + k * sizeof(Word), sizeof(Word));
+      mask.RecalculateMinMax();
+      mask.Move(a.dx - b.dx, a.dy - b.dy);
+      return true;
     }
+    return false;
+  }
 
-    // Flush run of live cells at end of line
-    if (last_val) {
-      if (run_count > 1)
-        result << run_count;
+  // Queues the mask of a pair to be written by the next Flush
+  void Add(const CanonicalCatalyst<N> &a, const CanonicalCatalyst<N> &b,
+           const LifeState<N> &mask) {
+    if (fd < 0 || !writable)
+      return;
 
-      result << "o";
+    LifeState<N> canonical = mask;
+    canonical.Move(b.dx - a.dx, b.dy - a.dy);
+    canonical.RecalculateMinMax();
+
+    Fields fields;
+    memset(&fields, 0, sizeof(fields));
+    fields.boardSize = N;
+    fields.cellsA = a.cells.size();
+    fields.cellsB = b.cells.size();
+    fields.min = canonical.min;
+    fields.width = canonical.BoundsWidth();
+
+    std::string payload((const char *)&fields, sizeof(fields));
+    payload.append(a.cells.begin(), a.cells.end());
+    payload.append(b.cells.begin(), b.cells.end());
+    for (int k = 0; k < fields.width; k++)
+      payload.append((const char *)&canonical.state[(fields.min + k) % N], sizeof(Word));
+
+    uint32_t header[2] = {(uint32_t)payload.size(),
+                          (uint32_t)HashBytes(payload.data(), payload.size())};
+    pendingKeys.push_back(std::make_pair(Key(a, b), pending.size()));
+    pending.append((const char *)header, sizeof(header));
+    pending.append(payload);
+  }
 
-      run_count = 0;
+  // Appends the queued records. Whatever other searches added in the
+  // meantime is indexed first, and a torn record at the end is dropped.
+  bool Flush() {
+    if (pending.empty())
+      return true;
+
+    flock(fd, LOCK_EX);
+    validEnd = Scan(validEnd);
+    bool ok = ftruncate(fd, validEnd) == 0 &&
+              pwrite(fd, pending.data(), pending.size(), validEnd) == (ssize_t)pending.size();
+    if (ok) {
+      for (auto &key : pendingKeys)
+        index.insert(std::make_pair(key.first, validEnd + key.second));
+      validEnd += pending.size();
+    } else if (ftruncate(fd, validEnd) != 0) {
+      ok = false;
     }
+    flock(fd, LOCK_UN);
+
+    pending.clear();
+    pendingKeys.clear();
+    return ok;
+  }
 
-    eol_count++;
+private:
+  struct Fields {
+    uint32_t boardSize;
+    uint16_t cellsA;
+    uint16_t cellsB;
+    int32_t min;
+    int32_t width;
+  };
+
+  static constexpr const char Magic[8] = {'C', 'F', 'M', 'A', 'S', 'K', 'S', '1'};
+  static const uint32_t MaxRecord = 1 << 20;
+
+  std::string fname;
+  int fd;
+  bool writable;
+  uint64_t validEnd;
+  std::unordered_multimap<uint64_t, uint64_t> index;
+  std::string pending;
+  std::vector<std::pair<uint64_t, uint64_t>> pendingKeys;
+
+  static uint64_t Key(const void *a, size_t aLength, const void *b, size_t bLength) {
+    return HashBytes(b, bLength, HashBytes(a, aLength, N));
+  }
+
+  static uint64_t Key(const CanonicalCatalyst<N> &a, const CanonicalCatalyst<N> &b) {
+    return Key(a.cells.data(), a.cells.size(), b.cells.data(), b.cells.size());
+  }
+
+  bool ReadRecord(uint64_t offset, std::string &payload) const {
+    uint32_t header[2];
+    if (pread(fd, header, sizeof(header), offset) != sizeof(header) ||
+        header[0] < sizeof(Fields) || header[0] > MaxRecord)
+      return false;
+    payload.resize(header[0]);
+    return pread(fd, &payload[0], header[0], offset + sizeof(header)) == (ssize_t)header[0] &&
+           (uint32_t)HashBytes(payload.data(), payload.size()) == header[1];
+  }
+
+  // Indexes the records from offset on, returning the end of the last
+  // whole one
+  uint64_t Scan(uint64_t offset) {
+    std::ifstream infile(fname.c_str(), std::ios::binary);
+    infile.seekg(offset);
+    std::string payload;
+    while (true) {
+      uint32_t header[2];
+      if (!infile.read((char *)header, sizeof(header)) ||
+          header[0] < sizeof(Fields) || header[0] > MaxRecord)
+        break;
+      payload.resize(header[0]);
+      if (!infile.read(&payload[0], header[0]) ||
+          (uint32_t)HashBytes(payload.data(), payload.size()) != header[1])
+        break;
+
+      Fields fields;
+      memcpy(&fields, payload.data(), sizeof(fields));
+      if (fields.boardSize == N &&
+          payload.size() == sizeof(fields) + fields.cellsA + fields.cellsB + fields.width * sizeof(Word)) {
+        const char *cells = payload.data() + sizeof(fields);
+        index.insert(std::make_pair(Key(cells, fields.cellsA, cells + fields.cellsA, fields.cellsB), offset));
+      }
+      offset += sizeof(header) + header[0];
+    }
+    return offset;
   }
+};
+
+template <int N> constexpr const char MaskCache<N>::Magic[8];
+
+// Spacing of the boards laid out by Category::RLE: the torus plus a
+// margin, one category per row.
+constexpr unsigned ResultTileSize(int boardSize) { return 36 + boardSize; }
 
-  // Flush trailing linefeeds
-  if (eol_count > 0) {
-    if (eol_count > 1)
-      result << eol_count;
+// Read back a file written by CategoryContainer::CategoriesRLE. Returns
+// the board of every tile keyed by (category row, position in the row)
+// together with the "#C" comment lines that precede the header.
+template <int N>
+std::map<std::pair<unsigned, unsigned>, LifeState<N>>
+ParseResultTiles(std::istream &in, std::vector<std::string> &comments) {
+  std::map<std::pair<unsigned, unsigned>, LifeState<N>> tiles;
 
-    result << "$";
+  std::string line;
+  std::string body;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 2, "#C") == 0)
+      comments.push_back(line);
+    else if (!line.empty() && line[0] != '#' && line[0] != 'x')
+      body += line;
+  }
 
-    eol_count = 0;
+  unsigned x = 0;
+  unsigned y = 0;
+  unsigned count = 0;
+  for (char ch : body) {
+    if (ch >= '0' && ch <= '9') {
+      count = 10 * count + (ch - '0');
+      continue;
+    }
+    if (count == 0)
+      count = 1;
+
+    if (ch == 'b') {
+      x += count;
+    } else if (ch == 'o') {
+      for (unsigned i = 0; i < count; i++, x++) {
+        unsigned tileX = x % ResultTileSize(N);
+        unsigned tileY = y % ResultTileSize(N);
+        if (tileX < N && tileY < N)
+          tiles[std::make_pair(y / ResultTileSize(N), x / ResultTileSize(N))]
+              .SetCell((int)tileX - N / 2, (int)tileY - N / 2, 1);
+      }
+    } else if (ch == '$') {
+      y += count;
+      x = 0;
+    } else if (ch == '!') {
+      break;
+    }
+    count = 0;
   }
 
-  return result.str();
+  return tiles;
 }
 
-class SearchResult {
+template <int N> class SearchResult {
 public:
   // Saved for the report
-  LifeState init;
+  LifeState<N> init;
 
   // iters state in form of integers
   // std::vector<int> params;
   unsigned maxGenSurvive;
   unsigned firstGenSurvive;
 
-  SearchResult(LifeState &initState, const Configuration &conf,
+  // Order in which a single-threaded search would have found it
+  uint64_t branch;
+  std::array<uint64_t, MAX_CATALYSTS> path;
+  unsigned seq;
+
+  SearchResult(LifeState<N> &initState, const Configuration<N> &conf,
                unsigned firstGenSurviveIn, unsigned genSurvive) {
     init.Copy(initState);
 
     maxGenSurvive = genSurvive;
     firstGenSurvive = firstGenSurviveIn;
+    branch = conf.branch;
+    path = conf.path;
+    seq = 0;
   }
 
   void Print() {
@@ -878,54 +1280,61 @@ public:
   }
 };
 
-class Category {
+template <int N> class Category {
 private:
   unsigned catDelta;
-  int maxgen;
-  uint64_t hash;
+  // The hash of categoryKey at every generation from its own up to
+  // maxgen
+  std::vector<uint64_t> phaseHashes;
 
 public:
-  LifeState categoryKey;
-  std::vector<SearchResult> results;
+  LifeState<N> categoryKey;
+  std::vector<SearchResult<N>> results;
+  // Position in CategoryContainer::categories
+  unsigned index{};
 
-  Category(LifeState &catalystRemoved, SearchResult &firstResult,
-           unsigned catDeltaIn, unsigned maxGen) {
+  Category(LifeState<N> &catalystRemoved, SearchResult<N> &firstResult,
+           unsigned catDeltaIn, const std::vector<uint64_t> &phaseHashesIn) {
     categoryKey = catalystRemoved;
     results.push_back(firstResult);
     catDelta = catDeltaIn;
-    maxgen = maxGen;
-
-    LifeState temp = categoryKey;
-    temp.Step(maxgen - temp.gen);
-    hash = temp.GetHash();
+    phaseHashes = phaseHashesIn;
   }
 
-  void Add(SearchResult &result) { results.push_back(result); }
-
-  bool BelongsTo(LifeState &test, const uint64_t &testHash) {
-    if (testHash != hash)
-      return false;
+  // The hashes of state at every generation from its own up to maxgen.
+  // These are full 64-bit hashes of the board, so two boards with the
+  // same hash are taken to be the same.
+  static std::vector<uint64_t> PhaseHashes(LifeState<N> state, int maxgen) {
+    std::vector<uint64_t> hashes;
+    while (true) {
+      hashes.push_back(HashBytes(state.state, sizeof(state.state)));
+      if (state.gen >= maxgen)
+        return hashes;
+      state.Step();
+    }
+  }
 
-    LifeState tempCat = categoryKey;
-    LifeState tempTest = test;
+  uint64_t Hash() const { return phaseHashes.back(); }
 
-    if (tempTest.gen > tempCat.gen)
-      tempCat.Step(tempTest.gen - tempCat.gen);
-    else if (tempTest.gen < tempCat.gen)
-      tempTest.Step(tempCat.gen - tempTest.gen);
+  void Add(SearchResult<N> &result) { results.push_back(result); }
 
+  // Whether a board at testGen with the given phase hashes becomes the
+  // same as the key within catDelta generations of both existing
+  bool BelongsTo(int testGen, const std::vector<uint64_t> &testHashes) const {
+    int gen = std::max(categoryKey.gen, testGen);
     for (unsigned i = 0; i < catDelta; i++) {
-      if (tempTest == tempCat)
+      unsigned catIndex = gen + i - categoryKey.gen;
+      unsigned testIndex = gen + i - testGen;
+      if (catIndex >= phaseHashes.size() || testIndex >= testHashes.size())
+        return false;
+      if (phaseHashes[catIndex] == testHashes[testIndex])
         return true;
-
-      tempCat.Step();
-      tempTest.Step();
     }
 
     return false;
   }
 
-  static bool CompareSearchResult(SearchResult &a, SearchResult &b) {
+  static bool CompareSearchResult(SearchResult<N> &a, SearchResult<N> &b) {
     return (a.maxGenSurvive - a.firstGenSurvive) >
            (b.maxGenSurvive - b.firstGenSurvive);
   }
@@ -939,34 +1348,48 @@ public:
       result.Print();
   }
 
-  std::string RLE(int maxCatSize) {
-    // 36 is extra margin to get 100
-    const unsigned Dist = 36 + 64;
+  // The first maxCatSize boards side by side, ResultTileSize(N) apart
+  void RLE(int maxCatSize, std::string &out) const {
+    typedef typename LifeState<N>::Word Word;
+    const unsigned Dist = ResultTileSize(N);
 
     unsigned howmany = results.size();
 
     if (maxCatSize != -1)
       howmany = std::min(howmany, (unsigned)maxCatSize);
 
-    unsigned width = Dist * howmany;
-    unsigned height = Dist;
-
-    std::vector<std::vector<bool>> vec(width, std::vector<bool>(height));
-
+    std::vector<Word> rows(howmany * N);
     for (unsigned l = 0; l < howmany; l++)
-      for (int j = 0; j < N; j++)
-        for (int i = 0; i < N; i++)
-          vec[Dist * l + i][j] = results[l].init.GetCell(i - 32, j - 32) == 1;
+      results[l].init.RLERows(&rows[l * N]);
 
-    return GetRLE(vec);
+    RLEWriter writer(out);
+    for (unsigned j = 0; j < Dist && howmany > 0; j++) {
+      for (unsigned l = 0; l < howmany; l++) {
+        if (j < N)
+          writer.Cells(rows[l * N + j], N);
+        else
+          writer.Dead(N);
+        writer.Dead(Dist - N);
+      }
+      writer.EndRow();
+    }
+    writer.Finish();
   }
 };
 
-class CategoryContainer {
+template <int N> class CategoryContainer {
 public:
-  std::vector<Category *> categories;
+  std::vector<Category<N> *> categories;
+  // The categories by the hash of their key at maxgen, in the order
+  // they were made
+  std::unordered_map<uint64_t, std::vector<Category<N> *>> categoriesByHash;
   unsigned catDelta;
   unsigned maxgen;
+  unsigned added{};
+  // Every result as its category and its index there, in the order they
+  // were added, and how many of them have been streamed out
+  std::vector<std::pair<unsigned, unsigned>> additions;
+  unsigned streamed{};
 
   explicit CategoryContainer(unsigned maxGen) {
     catDelta = 14;
@@ -978,32 +1401,58 @@ public:
     maxgen = maxGen + catDelta;
   }
 
-  void Add(LifeState &init, const LifeState &afterCatalyst, const LifeState &catalysts,
-           const Configuration &conf, unsigned firstGenSurvive,
-           unsigned genSurvive) {
+  ~CategoryContainer() {
+    for (auto &category : categories)
+      delete category;
+  }
 
-    LifeState result = afterCatalyst ^ catalysts;
-    result.gen = firstGenSurvive;
+  CategoryContainer(const CategoryContainer &) = delete;
+  CategoryContainer &operator=(const CategoryContainer &) = delete;
+
+  void Add(LifeState<N> &init, const LifeState<N> &afterCatalyst, const LifeState<N> &catalysts,
+           const Configuration<N> &conf, unsigned firstGenSurvive,
+           unsigned genSurvive) {
 
-    result.Step(maxgen - result.gen);
-    uint64_t hash = result.GetHash();
+    LifeState<N> categoryKey = afterCatalyst ^ catalysts;
+    categoryKey.gen = firstGenSurvive;
 
-    result = afterCatalyst ^ catalysts;
-    result.gen = firstGenSurvive;
+    // Boards that end up the same also agree at maxgen, so only the
+    // categories with the same hash there can match
+    std::vector<uint64_t> hashes = Category<N>::PhaseHashes(categoryKey, maxgen);
+    std::vector<Category<N> *> &candidates = categoriesByHash[hashes.back()];
 
-    for (auto & category: categories) {
-      if (category->BelongsTo(result, hash)) {
-          SearchResult r(init, conf, firstGenSurvive, genSurvive);
+    for (auto & category: candidates) {
+      if (category->BelongsTo(firstGenSurvive, hashes)) {
+          SearchResult<N> r(init, conf, firstGenSurvive, genSurvive);
+          r.seq = added++;
           category->Add(r);
+          additions.push_back(std::make_pair(category->index, category->results.size() - 1));
           return;
       }
     }
 
-    LifeState categoryKey = afterCatalyst ^ catalysts;
-    categoryKey.gen = firstGenSurvive;
+    SearchResult<N> r(init, conf, firstGenSurvive, genSurvive);
+    r.seq = added++;
+    categories.push_back(new Category<N>(categoryKey, r, catDelta, hashes));
+    categories.back()->index = categories.size() - 1;
+    candidates.push_back(categories.back());
+    additions.push_back(std::make_pair(categories.size() - 1, 0));
+  }
 
-    SearchResult r(init, conf, firstGenSurvive, genSurvive);
-    categories.push_back(new Category(categoryKey, r, catDelta, maxgen));
+  // One line for each result added since the last call: its category,
+  // the generations it survived, and the RLE of its board with the top
+  // left corner at (-N/2, -N/2)
+  std::string StreamRecords() {
+    std::string records;
+    for (; streamed < additions.size(); streamed++) {
+      unsigned c = additions[streamed].first;
+      const SearchResult<N> &result = categories[c]->results[additions[streamed].second];
+      records += std::to_string(c) + " " + std::to_string(result.firstGenSurvive) + " " +
+                 std::to_string(result.maxGenSurvive) + " ";
+      result.init.RLE(records);
+      records += "!\n";
+    }
+    return records;
   }
 
   void Sort() {
@@ -1017,232 +1466,1568 @@ public:
   }
 
   std::string CategoriesRLE(int maxCatSize) {
+    std::string rle;
+    for (auto & category: categories)
+      category->RLE(maxCatSize, rle);
+
+    return rle;
+  }
+
+  // One "#C result" line per tile written by CategoriesRLE, carrying what
+  // the board alone does not: the generations the result survived.
+  std::string ResultsComments(int maxCatSize) {
     std::stringstream ss;
-    for (auto & category: categories) {
-      ss << category->RLE(maxCatSize);
+    for (unsigned c = 0; c < categories.size(); c++) {
+      unsigned howmany = categories[c]->results.size();
+      if (maxCatSize != -1)
+        howmany = std::min(howmany, (unsigned)maxCatSize);
+
+      for (unsigned l = 0; l < howmany; l++) {
+        const SearchResult<N> &result = categories[c]->results[l];
+        ss << "#C result " << c << " " << l << " " << result.firstGenSurvive
+           << " " << result.maxGenSurvive << " " << result.branch << " "
+           << result.seq << "\n";
+      }
     }
 
     return ss.str();
   }
 };
 
+// Shards split the depth-0 placements of one search between independent
+// runs. The assignment only depends on the placement itself, so it is
+// the same on every machine and every shard sees the same masks.
+inline bool PlacementInShard(unsigned gen, unsigned s, int x, int y,
+                             unsigned shardIndex, unsigned shardCount) {
+  if (shardCount <= 1)
+    return true;
 
-class CatalystSearcher {
-public:
-  clock_t begin{};
-  SearchParams params;
-  LifeState pat;
-  LifeState alsoRequired;
-  std::vector<CatalystData> catalysts;
-  std::vector<LifeTarget> targetFilter;
-  std::vector<LifeState> catalystCollisionMasks;
-
-  unsigned found{};
-  unsigned fullfound{};
-
-  CategoryContainer *categoryContainer{};
-  CategoryContainer *fullCategoryContainer{};
+  uint64_t h = ((uint64_t)gen << 40) ^ ((uint64_t)s << 16) ^ ((uint64_t)x << 8) ^ (uint64_t)y;
+  return Mix64(h) % shardCount == shardIndex;
+}
 
-  bool hasFilter{};
-  bool hasMustInclude{};
-  bool reportAll{};
+std::string ShardFileName(const std::string &fname, unsigned shardIndex, unsigned shardCount) {
+  std::stringstream ss;
+  std::string::size_type dot = fname.rfind('.');
+  std::string::size_type slash = fname.rfind('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    dot = fname.size();
+  ss << fname.substr(0, dot) << "-shard-" << shardIndex << "-of-" << shardCount
+     << fname.substr(dot);
+  return ss.str();
+}
 
-  unsigned filterMaxGen{};
+// A fixed set of worker threads, each with its own deque of tasks. A
+// worker runs its own newest task first and, once it runs dry, steals
+// the oldest task of another worker. Threads outside the pool submit
+// round-robin and block while too many tasks are queued.
+class ThreadPool {
+public:
+  typedef std::function<void()> Task;
+
+  explicit ThreadPool(unsigned numThreads)
+      : queued(0), pending(0), idle(0), stopping(false), nextWorker(0) {
+    maxQueued = 4 * numThreads;
+    for (unsigned i = 0; i < numThreads; i++)
+      workers.emplace_back(new Worker());
+    for (unsigned i = 0; i < numThreads; i++)
+      threads.emplace_back(&ThreadPool::Run, this, i);
+  }
 
-  uint64_t AllCatalystsHash() const {
-    uint64_t result = 0;
-    for (auto &cat : catalysts) {
-      result ^= cat.state.GetHash();
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
     }
-    return result;
+    wake.notify_all();
+    for (auto &thread : threads)
+      thread.join();
   }
 
-  void LoadMasks() {
-    if (params.numCatalysts == 1)
-      return;
-
-    catalystCollisionMasks = std::vector<LifeState>(catalysts.size() * catalysts.size());
-
-    std::stringstream ss;
-    ss << "maskpack-" << AllCatalystsHash();
-    std::string fname = ss.str();
-
-    // See if the pack exists
-    std::ifstream infile;
-    infile.open(fname.c_str(), std::ios::binary);
-    if (infile.good()) {
-      for (unsigned s = 0; s < catalysts.size(); s++) {
-        for (unsigned t = 0; t < catalysts.size(); t++) {
-          infile.read((char*)catalystCollisionMasks[s * catalysts.size() + t].state, N * sizeof(uint64_t));
-          catalystCollisionMasks[s * catalysts.size() + t].RecalculateMinMax();
-        }
+  void Submit(Task task) {
+    unsigned target;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (currentWorker >= 0) {
+        target = currentWorker;
+      } else {
+        space.wait(lock, [this] { return queued.load() < maxQueued; });
+        target = nextWorker;
+        nextWorker = (nextWorker + 1) % workers.size();
       }
-      return;
+      pending++;
+      queued++;
     }
 
-    // If not, load or generate the masks
-    for (unsigned s = 0; s < catalysts.size(); s++) {
-      for (unsigned t = 0; t < catalysts.size(); t++) {
-        if (params.numCatalysts == 2 && hasMustInclude &&
-            !catalysts[s].mustInclude && !catalysts[t].mustInclude)
-          continue;
-
-        if (params.numTransparent == 1 && catalysts[s].transparent &&
-            catalysts[t].transparent)
-          continue;
-
-        if(catalysts[s].sacrificial || catalysts[t].sacrificial)
-          continue;
-
-        catalystCollisionMasks[s * catalysts.size() + t] = LoadCollisionMask(catalysts[s], catalysts[t]);
-        catalystCollisionMasks[s * catalysts.size() + t].RecalculateMinMax();
-      }
+    {
+      std::lock_guard<std::mutex> lock(workers[target]->mutex);
+      workers[target]->tasks.push_back(std::move(task));
     }
+    wake.notify_one();
+  }
 
-    // Save the pack for next time
-    std::ofstream outfile;
-    outfile.open(fname.c_str(), std::ofstream::binary);
-    for (unsigned s = 0; s < catalysts.size(); s++) {
-      for (unsigned t = 0; t < catalysts.size(); t++) {
-        outfile.write((char *)catalystCollisionMasks[s * catalysts.size() + t].state, N * sizeof(uint64_t));
-      }
-    }
-    outfile.close();
+  // Blocks until every submitted task (and everything they spawned) is done
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending.load() == 0; });
   }
 
-  void Init(const char *inputFile) {
-    begin = clock();
+  // True when some worker would pick up a new task straight away
+  bool HasIdleWorker() const {
+    return idle.load(std::memory_order_relaxed) > 0 &&
+           queued.load(std::memory_order_relaxed) == 0;
+  }
 
-    std::vector<CatalystInput> inputcats;
-    ReadParams(inputFile, inputcats, params);
+  unsigned Size() const { return workers.size(); }
 
-    for (auto &input : inputcats) {
-      std::vector<CatalystData> newcats = CatalystData::FromInput(input);
-      catalysts.insert(catalysts.end(), newcats.begin(), newcats.end());
-    }
-    hasMustInclude = false;
-    for (auto &cat : catalysts) {
-      hasMustInclude = hasMustInclude || cat.mustInclude;
-    }
+  static int CurrentWorker() { return currentWorker; }
 
-    if (!hasMustInclude) {
-      for (auto &cat : catalysts) {
-        cat.mustInclude = true;
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> threads;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable space;
+  std::condition_variable done;
+
+  std::atomic<unsigned> queued;
+  std::atomic<unsigned> pending;
+  std::atomic<unsigned> idle;
+  unsigned maxQueued;
+  bool stopping;
+  unsigned nextWorker;
+
+  static thread_local int currentWorker;
+
+  bool TryTake(unsigned self, Task &task) {
+    {
+      Worker &own = *workers[self];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.tasks.empty()) {
+        task = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        return true;
       }
     }
 
-    pat = LifeState::Parse(params.pat.c_str(), params.xPat, params.yPat);
-    categoryContainer = new CategoryContainer(params.maxGen);
-    fullCategoryContainer = new CategoryContainer(params.maxGen);
+    for (unsigned i = 1; i < workers.size(); i++) {
+      Worker &victim = *workers[(self + i) % workers.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+      }
+    }
 
-    for (unsigned i = 0; i < params.targetFilter.size(); i++)
-      targetFilter.push_back(LifeTarget::Parse(params.targetFilter[i].c_str(),
-                                               params.filterdx[i], params.filterdy[i]));
+    return false;
+  }
 
-    LoadMasks();
+  void Run(unsigned self) {
+    currentWorker = self;
 
-    alsoRequired = LifeState::Parse(params.alsoRequired.c_str(), params.alsoRequiredXY.first, params.alsoRequiredXY.second);
+    while (true) {
+      Task task;
+      if (TryTake(self, task)) {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          queued--;
+        }
+        space.notify_one();
 
-    found = 0;
-    fullfound = 0;
+        task();
 
-    hasFilter = !params.targetFilter.empty();
-    reportAll = params.fullReportFile.length() != 0;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0)
+          done.notify_all();
+        continue;
+      }
 
-    filterMaxGen = FilterMaxGen();
+      std::unique_lock<std::mutex> lock(mutex);
+      if (queued.load() > 0)
+        continue;
+      if (stopping)
+        return;
+      idle++;
+      wake.wait(lock, [this] { return queued.load() > 0 || stopping; });
+      idle--;
+    }
   }
+};
 
-  unsigned FilterMaxGen() {
-    unsigned maxGen = params.maxGen;
-
-    for (unsigned j = 0; j < targetFilter.size(); j++) {
-      if (params.filterGen[j] >= 0 && params.filterGen[j] > maxGen)
-        maxGen = params.filterGen[j];
+thread_local int ThreadPool::currentWorker = -1;
 
-      if (params.filterGenRange[j].second >= 0 && params.filterGenRange[j].second > maxGen)
-        maxGen = params.filterGenRange[j].second;
+// Preallocated blocking masks for every depth of the search, so that
+// expanding a node never allocates. Frame d holds one mask per catalyst
+// for a node with d catalysts placed, and a node writes the masks of
+// each child into frame d + 1 in turn. Each worker owns one arena.
+template <int N> class MaskArena {
+public:
+  MaskArena(unsigned numMasksIn, unsigned numFrames) : numMasks(numMasksIn) {
+    stride = (numMasks * sizeof(LifeState<N>) + 63) / 64 * 64;
+    void *memory = nullptr;
+    if (posix_memalign(&memory, 64, std::max<size_t>(stride * numFrames, 64)) != 0) {
+      std::cout << "Could not allocate the mask arena" << std::endl;
+      exit(1);
     }
+    storage = static_cast<char *>(memory);
 
-    return maxGen;
+    for (unsigned d = 0; d < numFrames; d++)
+      for (unsigned s = 0; s < numMasks; s++)
+        new (Frame(d) + s) LifeState<N>();
   }
 
-  void Report(bool saveFile = true) const {
-    unsigned sec = (clock() - begin) / CLOCKS_PER_SEC + 1;
+  ~MaskArena() { free(storage); }
 
-    std::cout << "results: " << categoryContainer->categories.size() << "/"
-              << found;
-    if (params.fullReportFile.length() != 0) {
-      std::cout << ", unfiltered: " << fullCategoryContainer->categories.size() << "/"
-                << fullfound;
-    }
-    std::cout << ", now: ";
-    PrintTime(sec);
-    std::cout << std::endl;
+  MaskArena(const MaskArena &) = delete;
+  MaskArena &operator=(const MaskArena &) = delete;
 
-    if (saveFile) {
-      std::cout << "Saving " << params.outputFile << "... " << std::flush;
+  LifeState<N> *Frame(unsigned depth) {
+    return reinterpret_cast<LifeState<N> *>(storage + depth * stride);
+  }
 
-      std::ofstream catResultsFile(params.outputFile.c_str());
-      catResultsFile << "x = 0, y = 0, rule = B3/S23\n";
-      catResultsFile << categoryContainer->CategoriesRLE(params.maxCatSize);
-      catResultsFile.close();
-      std::cout << "Done!" << std::endl;
+private:
+  unsigned numMasks;
+  size_t stride;
+  char *storage;
+};
 
-      if (params.fullReportFile.length() != 0) {
-        std::cout << "Saving " << params.fullReportFile << "... " << std::flush;
+// The generations of a candidate solution, each simulated once and then
+// shared by the checks ReportSolution makes, which all replay the
+// reaction from generation 0. Each worker owns one and reuses its
+// storage for every solution.
+template <int N> class Replay {
+public:
+  // Replay these catalysts; generations up to quiet are the
+  // catalyst-free evolution base plus the catalysts
+  void Start(const LifeState<N> &catsIn, unsigned quietIn,
+             const std::vector<LifeState<N>> &baseIn) {
+    cats = catsIn;
+    quiet = quietIn;
+    base = &baseIn;
+    simulated = 0;
+    period = 0;
+  }
 
-        std::ofstream fullCatResultsFile(params.fullReportFile.c_str());
-        fullCatResultsFile << "x = 0, y = 0, rule = B3/S23\n";
-        fullCatResultsFile << fullCategoryContainer->CategoriesRLE(params.maxCatSize);
-        fullCatResultsFile.close();
-        std::cout << "Done!" << std::endl;
+  // Whether the board at gen is the same as Period() generations before,
+  // as far as the generations simulated so far show
+  bool Repeats(unsigned gen) const { return period != 0 && gen >= periodStart + period; }
+  unsigned Period() const { return period; }
+
+  // Valid until At is next called with a later generation
+  const LifeState<N> &At(unsigned gen) {
+    if (gens.size() <= gen)
+      gens.resize(gen + 1);
+
+    for (; simulated <= gen; simulated++) {
+      LifeState<N> &next = gens[simulated];
+      if (period != 0) {
+        next = gens[simulated - period];
+      } else if (simulated <= quiet) {
+        next = (*base)[simulated] | cats;
+      } else {
+        next = gens[simulated - 1];
+        next.Step();
+        for (unsigned p = 1; p <= MaxPeriod && p <= simulated; p++) {
+          if (next == gens[simulated - p]) {
+            period = p;
+            periodStart = simulated - p;
+            break;
+          }
+        }
       }
+      next.gen = simulated;
     }
+    return gens[gen];
   }
 
-  static void PrintTime(unsigned sec) {
-    unsigned hr = sec / 3600;
-    unsigned min = (sec / 60) - hr * 60;
-    unsigned secs = sec - 3600 * hr - 60 * min;
-    std::cout << std::setfill('0');
-    std::cout << hr << ":" << std::setw(2) << min << ":" << std::setw(2) << secs;
- }
+  // The longest period looked for, here and in RecursiveSearch
+  static const unsigned MaxPeriod = 3;
 
-  bool HasForbidden(Configuration &conf, unsigned curIter) {
-    LifeState workspace = conf.startingCatalysts;
-    workspace.JoinWSymChain(pat, params.symmetryChain);
+private:
+  LifeState<N> cats;
+  unsigned quiet{};
+  const std::vector<LifeState<N>> *base{};
+  std::vector<LifeState<N>> gens;
+  unsigned simulated{};
+  // Once the board repeats, the generations from periodStart on cycle
+  unsigned period{};
+  unsigned periodStart{};
+};
 
-    for (unsigned i = 0; i <= curIter + 1; i++) {
-      for (unsigned j = 0; j < params.numCatalysts; j++) {
-        for (unsigned k = 0; k < catalysts[conf.curs[j]].forbidden.size(); k++) {
-          if (workspace.Contains(catalysts[conf.curs[j]].forbidden[k], conf.curx[j], conf.cury[j]))
-            return true;
-        }
+// The last few boards of a branch, to spot when it starts to cycle
+template <int N> class CycleWatch {
+public:
+  void Reset() { recorded = 0; }
+
+  // The period of the boards so far if board is the same as one of the
+  // last Replay<N>::MaxPeriod, otherwise 0; the board is recorded either
+  // way
+  unsigned Push(const LifeState<N> &board) {
+    unsigned period = 0;
+    for (unsigned p = 1; p <= Replay<N>::MaxPeriod && p <= recorded; p++) {
+      if (board == boards[(recorded - p) % Size]) {
+        period = p;
+        break;
       }
-      workspace.Step();
     }
+    boards[recorded % Size] = board;
+    recorded++;
+    return period;
+  }
 
-    return false;
+  // The board pushed ago pushes before the last
+  const LifeState<N> &Back(unsigned ago) const { return boards[(recorded - 1 - ago) % Size]; }
+
+private:
+  static const unsigned Size = Replay<N>::MaxPeriod + 1;
+  LifeState<N> boards[Size];
+  unsigned recorded{};
+};
+
+// What the search did at each depth, i.e. with that many catalysts
+// already placed. Each worker owns one and is the only thread that
+// writes it, so a count is a relaxed load and store rather than a locked
+// increment, and Report can still read every worker's counts while the
+// search runs.
+class SearchStats {
+public:
+  enum Counter {
+    NODES,          // Calls of RecursiveSearch
+    GENERATIONS,    // Generations stepped by those calls
+    PLACEMENTS,     // Catalyst placements tried
+    NO_INTERACTION, // Placements the catalyst doesn't interact at
+    DESTROYED,      // Placements breaking required or antirequired cells
+    NOT_RECOVERED,  // Placements failing check-recovery
+    DISAPPEARED,    // Branches failed by a catalyst missing for too long
+    FORBIDDEN,      // Solutions containing a forbidden pattern
+    FILTERED,       // Solutions failing the filters
+    CATEGORIES,     // New categories of results
+    NUM_COUNTERS
+  };
+
+  static const char *Name(Counter counter) {
+    static const char *names[NUM_COUNTERS] = {
+        "nodes",     "gens",          "placements",  "no-interaction", "destroyed",
+        "not-recovered", "disappeared", "forbidden", "filtered",       "categories"};
+    return names[counter];
   }
 
-  bool FilterForCurrentGenFail(LifeState &workspace) {
-    for (unsigned j = 0; j < targetFilter.size(); j++) {
-      if (workspace.gen == params.filterGen[j] &&
-          workspace.Contains(targetFilter[j]) == false) {
-        return true;
-      }
-    }
+  SearchStats() {
+    for (auto &depth : counts)
+      for (auto &count : depth)
+        count.store(0, std::memory_order_relaxed);
+  }
 
-    return false;
+  void Add(Counter counter, unsigned depth, uint64_t n = 1) {
+    std::atomic<uint64_t> &count = counts[depth][counter];
+    count.store(count.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
   }
 
-  bool ValidateFilters(Configuration &conf, unsigned successtime, unsigned failuretime) {
-    LifeState workspace = conf.startingCatalysts;
-    workspace.JoinWSymChain(pat, params.symmetryChain);
+  uint64_t Get(Counter counter, unsigned depth) const {
+    return counts[depth][counter].load(std::memory_order_relaxed);
+  }
 
+private:
+  std::atomic<uint64_t> counts[MAX_CATALYSTS + 1][NUM_COUNTERS];
+};
+
+// The collision masks of every pair of catalysts, memory-mapped from a
+// maskstore file. Each mask is stored as just the columns between its
+// bounds, so the masks of a large catalyst list take a fraction of the
+// space of full LifeStates, and pages of the file are only read in once
+// the search first looks at a pair on them.
+//
+// The file is a header, then one record per distinct mask (its bounds,
+// then its columns, padded to RecordAlign bytes), then a table giving
+// the offset of the record of every pair. Offset sizeof(Header) is the
+// empty mask.
+template <int N> class CollisionMaskStore {
+public:
+  typedef typename LifeState<N>::Word Word;
+
+  struct Mask {
+    int min;
+    int width;
+    const Word *columns;
+
+    bool IsEmpty() const { return width == 0; }
+  };
+
+  static const size_t RecordAlign = 16;
+
+  CollisionMaskStore() : data(nullptr), size(0), count(0), table(nullptr) {}
+
+  ~CollisionMaskStore() {
+    if (data != nullptr)
+      munmap(data, size);
+  }
+
+  CollisionMaskStore(const CollisionMaskStore &) = delete;
+  CollisionMaskStore &operator=(const CollisionMaskStore &) = delete;
+
+  // Maps the file if it holds count masks for this board size
+  bool Open(const std::string &fname, uint64_t countIn) {
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Header)) {
+      close(fd);
+      return false;
+    }
+
+    void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+      return false;
+
+    const Header *header = static_cast<const Header *>(mapped);
+    if (memcmp(header->magic, Magic(), sizeof(header->magic)) != 0 ||
+        header->boardSize != N || header->count != countIn ||
+        header->tableOffset + countIn * sizeof(uint64_t) > (uint64_t)info.st_size) {
+      munmap(mapped, info.st_size);
+      return false;
+    }
+
+    if (data != nullptr)
+      munmap(data, size);
+    data = static_cast<char *>(mapped);
+    size = info.st_size;
+    count = countIn;
+    table = reinterpret_cast<const uint64_t *>(data + header->tableOffset);
+    return true;
+  }
+
+  Mask Get(uint64_t pair) const {
+    const Record *record = reinterpret_cast<const Record *>(data + table[pair]);
+    Mask mask;
+    mask.min = record->min;
+    mask.width = record->width;
+    mask.columns = reinterpret_cast<const Word *>(record + 1);
+    return mask;
+  }
+
+  // Writes a store one mask at a time, in pair order
+  class Writer {
+  public:
+    Writer(const std::string &fname, uint64_t countIn)
+        : file(fopen(fname.c_str(), "wb")), position(0), ok(file != nullptr) {
+      if (!ok)
+        return;
+      offsets.reserve(countIn);
+
+      Header header;
+      memset(&header, 0, sizeof(header));
+      Write(&header, sizeof(header));
+
+      // The empty mask
+      Record empty;
+      memset(&empty, 0, sizeof(empty));
+      Write(&empty, sizeof(empty));
+    }
+
+    bool Good() const { return ok; }
+
+    void Add(const LifeState<N> &mask) {
+      int width = mask.BoundsWidth();
+      if (width == 0) {
+        offsets.push_back(sizeof(Header));
+        return;
+      }
+
+      offsets.push_back(position);
+      Record record;
+      memset(&record, 0, sizeof(record));
+      record.min = mask.min;
+      record.width = width;
+      Write(&record, sizeof(record));
+      for (int k = 0; k < width; k++)
+        Write(&mask.state[(mask.min + k) % N], sizeof(Word));
+      Pad();
+    }
+
+    // The next mask is the same as an earlier one
+    void AddCopy(uint64_t pair) { offsets.push_back(offsets[pair]); }
+
+    bool Finish() {
+      Header header;
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, Magic(), sizeof(header.magic));
+      header.boardSize = N;
+      header.count = offsets.size();
+      header.tableOffset = position;
+      Write(offsets.data(), offsets.size() * sizeof(uint64_t));
+
+      ok = ok && fseek(file, 0, SEEK_SET) == 0 &&
+           fwrite(&header, sizeof(header), 1, file) == 1;
+      ok = fclose(file) == 0 && ok;
+      file = nullptr;
+      return ok;
+    }
+
+  private:
+    FILE *file;
+    uint64_t position;
+    bool ok;
+    std::vector<uint64_t> offsets;
+
+    void Write(const void *bytes, size_t length) {
+      ok = ok && fwrite(bytes, 1, length, file) == length;
+      position += length;
+    }
+
+    void Pad() {
+      static const char zeros[RecordAlign] = {0};
+      Write(zeros, (RecordAlign - position % RecordAlign) % RecordAlign);
+    }
+  };
+
+private:
+  struct Header {
+    char magic[8];
+    uint32_t boardSize;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t tableOffset;
+  };
+
+  struct Record {
+    int32_t min;
+    int32_t width;
+    int32_t reserved[2];
+  };
+
+  static_assert(sizeof(Header) % RecordAlign == 0, "maskstore header is misaligned");
+  static_assert(sizeof(Record) % RecordAlign == 0, "maskstore record is misaligned");
+
+  static const char *Magic() { return "CFMASK1"; }
+
+  char *data;
+  size_t size;
+  uint64_t count;
+  const uint64_t *table;
+};
+
+template <int N> struct CheckpointResult {
+  bool full;
+  uint64_t branch;
+  unsigned firstGenSurvive;
+  unsigned maxGenSurvive;
+  LifeState<N> init;
+};
+
+// Append-only journal of the first-catalyst branches that have been
+// searched completely, and of the results they produced. Records are
+// buffered in memory and written out by a background thread, so the
+// search never waits on the disk. A branch is only journaled once every
+// task it was split into has finished, so replaying the journal is the
+// same as having searched those branches again.
+class Checkpoint {
+public:
+  Checkpoint(const std::string &fnameIn, uint64_t fingerprintIn, unsigned intervalIn)
+      : fname(fnameIn), fingerprint(fingerprintIn), interval(intervalIn),
+        file(nullptr), stopping(false) {}
+
+  ~Checkpoint() { Stop(); }
+
+  // Read the journal left by an earlier run of the same search. Results
+  // are returned in the order their branches finished.
+  template <int N> bool Load(std::vector<CheckpointResult<N>> &results) {
+    std::ifstream infile(fname.c_str());
+    if (!infile.good())
+      return false;
+
+    std::string line;
+    std::getline(infile, line);
+    std::vector<std::string> header = splitwhitespace(line);
+    if (header.size() != 3 || header[0] != "CatForce-checkpoint" || header[1] != "1" ||
+        strtoull(header[2].c_str(), nullptr, 10) != fingerprint) {
+      std::cout << "Checkpoint " << fname << " belongs to a different search" << std::endl;
+      exit(1);
+    }
+
+    std::map<uint64_t, std::vector<CheckpointResult<N>>> unfinished;
+    while (std::getline(infile, line)) {
+      std::vector<std::string> elems = splitwhitespace(line);
+      if (elems.size() == 6 && elems[0] == "result") {
+        CheckpointResult<N> result;
+        result.full = elems[1] == "full";
+        result.branch = strtoull(elems[2].c_str(), nullptr, 10);
+        result.firstGenSurvive = atoi(elems[3].c_str());
+        result.maxGenSurvive = atoi(elems[4].c_str());
+        result.init = LifeState<N>::Parse(elems[5].c_str(), -N / 2, -N / 2);
+        unfinished[result.branch].push_back(result);
+      } else if (elems.size() == 6 && elems[0] == "branch") {
+        uint64_t branch = strtoull(elems[1].c_str(), nullptr, 10);
+        // A torn last line would not match its own key
+        if (branch != BranchKey(atoi(elems[2].c_str()), atoi(elems[3].c_str()),
+                                atoi(elems[4].c_str()), atoi(elems[5].c_str())))
+          continue;
+        done.insert(branch);
+        std::vector<CheckpointResult<N>> &branchResults = unfinished[branch];
+        results.insert(results.end(), branchResults.begin(), branchResults.end());
+        unfinished.erase(branch);
+      }
+    }
+
+    return true;
+  }
+
+  void Start(bool append) {
+    file = fopen(fname.c_str(), append ? "a" : "w");
+    if (file == nullptr) {
+      std::cout << "Could not open checkpoint " << fname << std::endl;
+      exit(1);
+    }
+    if (!append)
+      fprintf(file, "CatForce-checkpoint 1 %llu\n", (unsigned long long)fingerprint);
+    fflush(file);
+
+    writer = std::thread(&Checkpoint::Write, this);
+  }
+
+  bool IsDone(uint64_t branch) const { return done.count(branch) != 0; }
+
+  // Every task working on a branch holds a reference to it
+  void Retain(uint64_t branch) {
+    std::lock_guard<std::mutex> lock(mutex);
+    open[branch].outstanding++;
+  }
+
+  void Release(uint64_t branch) {
+    std::lock_guard<std::mutex> lock(mutex);
+    OpenBranch &b = open[branch];
+    if (--b.outstanding != 0)
+      return;
+
+    buffer += b.records;
+    std::stringstream ss;
+    ss << "branch " << branch << " " << (branch >> 32) << " " << ((branch >> 16) & 0xFFFF)
+       << " " << ((branch >> 8) & 0xFF) << " " << (branch & 0xFF) << "\n";
+    buffer += ss.str();
+    open.erase(branch);
+  }
+
+  template <int N>
+  void AddResult(uint64_t branch, bool full, const LifeState<N> &init,
+                 unsigned firstGenSurvive, unsigned maxGenSurvive) {
+    std::stringstream ss;
+    ss << "result " << (full ? "full" : "filtered") << " " << branch << " "
+       << firstGenSurvive << " " << maxGenSurvive << " " << init.RLE() << "\n";
+
+    std::lock_guard<std::mutex> lock(mutex);
+    open[branch].records += ss.str();
+  }
+
+  void SetGen(unsigned gen) {
+    std::stringstream ss;
+    ss << "gen " << gen << "\n";
+
+    std::lock_guard<std::mutex> lock(mutex);
+    buffer += ss.str();
+  }
+
+  // The search is complete, so there is nothing left to resume
+  void Finish() {
+    if (Stop())
+      remove(fname.c_str());
+  }
+
+private:
+  struct OpenBranch {
+    unsigned outstanding = 0;
+    std::string records;
+  };
+
+  std::string fname;
+  uint64_t fingerprint;
+  unsigned interval;
+  FILE *file;
+
+  std::set<uint64_t> done;
+  std::map<uint64_t, OpenBranch> open;
+  std::string buffer;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::thread writer;
+  bool stopping;
+
+  // Write out what is buffered and close the file, or false if it was
+  // not open
+  bool Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (file == nullptr || stopping)
+        return false;
+      stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+    fclose(file);
+    file = nullptr;
+    return true;
+  }
+
+  void Write() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wake.wait_for(lock, std::chrono::seconds(interval), [this] { return stopping; });
+
+      std::string chunk;
+      chunk.swap(buffer);
+      bool last = stopping;
+
+      lock.unlock();
+      fwrite(chunk.data(), 1, chunk.size(), file);
+      fflush(file);
+      lock.lock();
+
+      if (last)
+        return;
+    }
+  }
+};
+
+// FNV-1a over the input file, so a checkpoint is never resumed into a
+// different search
+uint64_t InputFingerprint(const char *inputFile, unsigned shardIndex, unsigned shardCount) {
+  std::ifstream infile(inputFile, std::ios::binary);
+  std::stringstream ss;
+  ss << infile.rdbuf() << "\nshard " << shardIndex << "/" << shardCount;
+  std::string contents = ss.str();
+
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (char ch : contents) {
+    hash ^= (unsigned char)ch;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+enum PlacementVerdict {
+  PLACEMENT_OK,
+  PLACEMENT_NO_INTERACTION,
+  PLACEMENT_DESTROYED,
+  PLACEMENT_NOT_RECOVERED
+};
+
+// Consecutive placements of one catalyst, in FirstOn order, whose
+// lookaheads are run together
+template <int N> struct PlacementBatch {
+  unsigned size;
+  std::array<std::pair<int, int>, LifeStateBatch<N>::Lanes> placements;
+  std::array<LifeState<N>, LifeStateBatch<N>::Lanes> shiftedCatalyst;
+  std::array<LifeState<N>, LifeStateBatch<N>::Lanes> symCatalyst;
+  std::array<LifeState<N>, LifeStateBatch<N>::Lanes> required;
+  std::array<LifeState<N>, LifeStateBatch<N>::Lanes> antirequired;
+  std::array<PlacementVerdict, LifeStateBatch<N>::Lanes> verdict;
+};
+
+// Reports how far along the collision masks are, at most once a second
+class MaskProgress {
+public:
+  explicit MaskProgress(unsigned total)
+      : total(total), done(0), begin(std::chrono::steady_clock::now()),
+        lastReport(begin) {}
+
+  void Done() {
+    unsigned count = ++done;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastReport < std::chrono::seconds(1))
+      return;
+    lastReport = now;
+    std::cout << "\rCollision masks: " << count << "/" << total << std::flush;
+  }
+
+  void Finish() {
+    if (total == 0)
+      return;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    std::cout << "\rCollision masks: " << total << "/" << total << " in "
+              << std::fixed << std::setprecision(1) << elapsed.count() << "s"
+              << std::defaultfloat << std::endl;
+  }
+
+private:
+  unsigned total;
+  std::atomic<unsigned> done;
+  std::chrono::steady_clock::time_point begin;
+  std::chrono::steady_clock::time_point lastReport;
+  std::mutex mutex;
+};
+
+// Set by SIGUSR1 to have the next Report write the full output
+volatile std::sig_atomic_t saveRequested = 0;
+
+extern "C" void RequestSave(int) { saveRequested = 1; }
+
+template <int N> class CatalystSearcher {
+public:
+  std::chrono::steady_clock::time_point begin;
+  SearchParams params;
+  LifeState<N> pat;
+  LifeState<N> alsoRequired;
+  std::vector<CatalystData<N>> catalysts;
+  std::vector<LifeTarget<N>> targetFilter;
+  CollisionMaskStore<N> collisionMasks;
+
+  // One per pool worker, plus one for the main thread
+  std::vector<std::unique_ptr<MaskArena<N>>> arenas;
+  // Likewise, for the convolutions of TryAddingCatalyst at each depth
+  std::vector<std::unique_ptr<MaskArena<N>>> convolutionArenas;
+  // Likewise, see SearchStats, Replay and CycleWatch
+  std::vector<std::unique_ptr<SearchStats>> stats;
+  std::vector<std::unique_ptr<Replay<N>>> replays;
+  std::vector<std::unique_ptr<CycleWatch<N>>> cycleWatches;
+
+  unsigned found{};
+  unsigned fullfound{};
+
+  CategoryContainer<N> *categoryContainer{};
+  CategoryContainer<N> *fullCategoryContainer{};
+
+  // Guards the category containers and counters once workers are running
+  mutable std::mutex resultsMutex;
+
+  // New results, appended by every Report
+  std::ofstream resultStream;
+  std::ofstream fullResultStream;
+  ThreadPool *pool{};
+
+  unsigned shardIndex{};
+  unsigned shardCount{1};
+
+  Checkpoint *checkpoint{};
+  bool resume{};
+
+  // The kernels TryAddingCatalyst convolves the active part with, for
+  // one combination of the restrictions on which catalysts it can place.
+  // Catalysts whose reaction or avoid masks are the same up to
+  // translation share a slot, and move its convolution by their offset.
+  struct PlacementKernels {
+    std::vector<const LifeKernel<N> *> kernels;
+    std::vector<int> reactionSlot; // By catalyst, -1 when it can't be placed
+    std::vector<int> avoidSlot;    // By catalyst, -1 when it has no locus
+  };
+  // Indexed by whether no more transparent catalysts can be placed and
+  // whether only must-include ones can
+  PlacementKernels placementKernels[2][2];
+  std::vector<std::pair<int, int>> reactionOffsets;
+  std::vector<std::pair<int, int>> avoidOffsets;
+
+  bool hasFilter{};
+  bool hasMustInclude{};
+  bool reportAll{};
+
+  unsigned filterMaxGen{};
+  // The filters that can be checked at each generation up to
+  // filterMaxGen, in input order
+  std::vector<std::vector<unsigned>> filterSchedule;
+  // For each match filter, its target in each orientation of D8
+  std::vector<std::vector<LifeMatcher<N>>> filterMatchers;
+
+  // The pattern (with its symmetric copies) evolving with no catalysts,
+  // indexed by generation
+  std::vector<LifeState<N>> baseEvolution;
+  // Cells within distance 2 of the catalyst-free pattern at any
+  // generation before the index. A stable catalyst outside baseReach[g]
+  // has not been touched before generation g.
+  std::vector<LifeState<N>> baseReach;
+  // Placements blocked by interactions before start-gen
+  std::vector<LifeState<N>> startGenBlocking;
+
+  // Whether TryAddingCatalyst can ever need the mask of s against t
+  bool NeedsMask(unsigned s, unsigned t) const {
+    if (params.numCatalysts == 2 && hasMustInclude &&
+        !catalysts[s].mustInclude && !catalysts[t].mustInclude)
+      return false;
+
+    if (params.numTransparent == 1 && catalysts[s].transparent &&
+        catalysts[t].transparent)
+      return false;
+
+    if(catalysts[s].sacrificial || catalysts[t].sacrificial)
+      return false;
+
+    return true;
+  }
+
+  void LoadMasks() {
+    if (params.numCatalysts == 1)
+      return;
+
+    uint64_t numPairs = (uint64_t)catalysts.size() * catalysts.size();
+
+    std::vector<CanonicalCatalyst<N>> canonicalForms;
+    for (auto &cat : catalysts)
+      canonicalForms.push_back(CanonicalCatalyst<N>(cat.state));
+
+    // The store for this search is named after everything that goes in
+    // it: the catalysts, where they are, and which pairs are needed
+    uint64_t storeHash = HashBytes(nullptr, 0, N);
+    for (auto &form : canonicalForms) {
+      int offset[2] = {form.dx, form.dy};
+      storeHash = HashBytes(offset, sizeof(offset), storeHash);
+      storeHash = HashBytes(form.cells.data(), form.cells.size(), storeHash);
+    }
+    std::vector<uint8_t> needed;
+    for (unsigned s = 0; s < catalysts.size(); s++)
+      for (unsigned t = 0; t < catalysts.size(); t++)
+        needed.push_back(NeedsMask(s, t));
+    storeHash = HashBytes(needed.data(), needed.size(), storeHash);
+
+    std::stringstream ss;
+    ss << "maskstore-";
+    if (N != 64)
+      ss << N << "-";
+    ss << std::hex << std::setw(16) << std::setfill('0') << storeHash;
+    std::string fname = ss.str();
+
+    // See if the store exists
+    if (collisionMasks.Open(fname, numPairs))
+      return;
+
+    // If not, take the masks from the shared cache, or generate them.
+    // Identical catalysts (usually from a symmetric catalyst with too
+    // many transformations) share their masks, so each distinct pair is
+    // done once.
+    std::string cacheDir = MaskCacheDirectory();
+    MaskCache<N> cache;
+    if (!MakeDirectories(cacheDir) || !cache.Open(cacheDir + "/collision-masks"))
+      std::cout << "Not using the mask cache in " << cacheDir << std::endl;
+
+    std::vector<unsigned> canonical(catalysts.size());
+    std::unordered_multimap<uint64_t, unsigned> firstWithCells;
+    for (unsigned s = 0; s < catalysts.size(); s++) {
+      canonical[s] = s;
+      uint64_t key = HashBytes(catalysts[s].state.state, sizeof(catalysts[s].state.state));
+      auto range = firstWithCells.equal_range(key);
+      for (auto it = range.first; it != range.second; ++it) {
+        if (catalysts[it->second].state == catalysts[s].state) {
+          canonical[s] = it->second;
+          break;
+        }
+      }
+      if (canonical[s] == s)
+        firstWithCells.insert(std::make_pair(key, s));
+    }
+    auto isCopy = [&](unsigned s, unsigned t) {
+      return (canonical[s] != s || canonical[t] != t) &&
+             NeedsMask(canonical[s], canonical[t]);
+    };
+
+    unsigned total = 0;
+    for (unsigned s = 0; s < catalysts.size(); s++)
+      for (unsigned t = 0; t < catalysts.size(); t++)
+        if (NeedsMask(s, t) && !isCopy(s, t))
+          total++;
+
+    // The masks are done a row at a time and written straight out, so
+    // only one row is ever in memory
+    std::string tempName = fname + ".tmp";
+    typename CollisionMaskStore<N>::Writer writer(tempName, numPairs);
+    std::vector<LifeState<N>> row(catalysts.size());
+    std::vector<bool> generated(catalysts.size());
+    MaskProgress progress(total);
+    auto generate = [this, &row, &progress](unsigned s, unsigned t) {
+      row[t] = CollisionMask(catalysts[s].state, catalysts[t].state);
+      row[t].RecalculateMinMax();
+      progress.Done();
+    };
+
+    for (unsigned s = 0; s < catalysts.size() && writer.Good(); s++) {
+      for (unsigned t = 0; t < catalysts.size(); t++) {
+        row[t] = LifeState<N>();
+        generated[t] = false;
+        if (!NeedsMask(s, t) || isCopy(s, t))
+          continue;
+
+        if (cache.Lookup(canonicalForms[s], canonicalForms[t], row[t])) {
+          progress.Done();
+          continue;
+        }
+
+        generated[t] = true;
+        if (pool != nullptr)
+          pool->Submit([&generate, s, t] { generate(s, t); });
+        else
+          generate(s, t);
+      }
+      if (pool != nullptr)
+        pool->Wait();
+
+      for (unsigned t = 0; t < catalysts.size(); t++) {
+        if (generated[t])
+          cache.Add(canonicalForms[s], canonicalForms[t], row[t]);
+
+        if (NeedsMask(s, t) && isCopy(s, t))
+          writer.AddCopy(canonical[s] * catalysts.size() + canonical[t]);
+        else
+          writer.Add(row[t]);
+      }
+      cache.Flush();
+    }
+    progress.Finish();
+
+    if (!writer.Finish() || rename(tempName.c_str(), fname.c_str()) != 0 ||
+        !collisionMasks.Open(fname, numPairs)) {
+      std::cout << "Could not write the collision masks to " << fname << std::endl;
+      exit(1);
+    }
+  }
+
+  void Init(const char *inputFile, unsigned numThreads = 0) {
+    ReadInput(inputFile);
+
+    if (shardCount > 1) {
+      params.outputFile = ShardFileName(params.outputFile, shardIndex, shardCount);
+      if (reportAll)
+        params.fullReportFile = ShardFileName(params.fullReportFile, shardIndex, shardCount);
+    }
+
+    OpenStreams();
+
+    if (params.checkpointFile.empty())
+      params.checkpointFile = params.outputFile + ".checkpoint";
+    if (params.checkpointFile != "none") {
+      checkpoint = new Checkpoint(params.checkpointFile,
+                                  InputFingerprint(inputFile, shardIndex, shardCount),
+                                  params.checkpointInterval);
+
+      std::vector<CheckpointResult<N>> results;
+      if (resume && checkpoint->Load(results)) {
+        for (auto &result : results) {
+          if (result.full)
+            RestoreResult(result.init, result.branch, result.firstGenSurvive,
+                          result.maxGenSurvive, *fullCategoryContainer, fullfound);
+          else
+            RestoreResult(result.init, result.branch, result.firstGenSurvive,
+                          result.maxGenSurvive, *categoryContainer, found);
+        }
+        std::cout << "Resuming from " << params.checkpointFile << " with "
+                  << results.size() << " results" << std::endl;
+        checkpoint->Start(true);
+      } else {
+        if (resume)
+          std::cout << "No checkpoint " << params.checkpointFile
+                    << ", starting from scratch" << std::endl;
+        checkpoint->Start(false);
+      }
+    }
+
+    if (numThreads != 0)
+      params.numThreads = numThreads;
+    if (params.numThreads > 1)
+      pool = new ThreadPool(params.numThreads);
+
+    LoadMasks();
+    GroupPlacementKernels();
+
+    unsigned numArenas = pool != nullptr ? pool->Size() + 1 : 1;
+    for (unsigned i = 0; i < numArenas; i++) {
+      arenas.emplace_back(new MaskArena<N>(catalysts.size(), params.numCatalysts));
+      convolutionArenas.emplace_back(
+          new MaskArena<N>(placementKernels[0][0].kernels.size(), params.numCatalysts));
+      stats.emplace_back(new SearchStats());
+      replays.emplace_back(new Replay<N>());
+      cycleWatches.emplace_back(new CycleWatch<N>());
+    }
+  }
+
+  MaskArena<N> &LocalArena() { return *arenas[ThreadPool::CurrentWorker() + 1]; }
+  MaskArena<N> &LocalConvolutionArena() {
+    return *convolutionArenas[ThreadPool::CurrentWorker() + 1];
+  }
+  SearchStats &LocalStats() { return *stats[ThreadPool::CurrentWorker() + 1]; }
+  Replay<N> &LocalReplay() { return *replays[ThreadPool::CurrentWorker() + 1]; }
+  CycleWatch<N> &LocalCycleWatch() { return *cycleWatches[ThreadPool::CurrentWorker() + 1]; }
+
+  uint64_t TotalStat(SearchStats::Counter counter, unsigned depth) const {
+    uint64_t total = 0;
+    for (auto &worker : stats)
+      total += worker->Get(counter, depth);
+    return total;
+  }
+
+  uint64_t TotalStat(SearchStats::Counter counter) const {
+    uint64_t total = 0;
+    for (unsigned d = 0; d <= params.numCatalysts; d++)
+      total += TotalStat(counter, d);
+    return total;
+  }
+
+  // The counts of every worker so far, by depth if perDepth and
+  // otherwise just the throughput
+  void PrintStats(bool perDepth) const {
+    double sec = std::max(ElapsedSeconds(), 1e-3);
+    uint64_t nodes = TotalStat(SearchStats::NODES);
+    uint64_t gens = TotalStat(SearchStats::GENERATIONS);
+    printf("searched: %llu nodes (%.0f/s), %llu gens (%.0f/s)\n",
+           (unsigned long long)nodes, nodes / sec, (unsigned long long)gens, gens / sec);
+    if (!perDepth)
+      return;
+
+    printf("%-5s", "depth");
+    for (unsigned c = 0; c < SearchStats::NUM_COUNTERS; c++)
+      printf(" %14s", SearchStats::Name((SearchStats::Counter)c));
+    printf("\n");
+    for (unsigned d = 0; d <= params.numCatalysts; d++) {
+      printf("%-5u", d);
+      for (unsigned c = 0; c < SearchStats::NUM_COUNTERS; c++)
+        printf(" %14llu", (unsigned long long)TotalStat((SearchStats::Counter)c, d));
+      printf("\n");
+    }
+  }
+
+  void ReadInput(const char *inputFile) {
+    begin = std::chrono::steady_clock::now();
+
+    std::vector<CatalystInput> inputcats;
+    ReadParams(inputFile, inputcats, params);
+
+    unsigned duplicates = 0;
+    for (auto &input : inputcats) {
+      std::vector<CatalystData<N>> newcats = CatalystData<N>::FromInput(input);
+      duplicates += CharToTransforms(input.symmType).size() - newcats.size();
+      catalysts.insert(catalysts.end(), newcats.begin(), newcats.end());
+    }
+    if (duplicates > 0)
+      std::cout << "Dropped " << duplicates << " duplicate catalyst transformations, leaving "
+                << catalysts.size() << " catalysts" << std::endl;
+    hasMustInclude = false;
+    for (auto &cat : catalysts) {
+      hasMustInclude = hasMustInclude || cat.mustInclude;
+    }
+
+    if (!hasMustInclude) {
+      for (auto &cat : catalysts) {
+        cat.mustInclude = true;
+      }
+    }
+
+    pat = LifeState<N>::Parse(params.pat.c_str(), params.xPat, params.yPat);
+    categoryContainer = new CategoryContainer<N>(params.maxGen);
+    fullCategoryContainer = new CategoryContainer<N>(params.maxGen);
+
+    for (unsigned i = 0; i < params.targetFilter.size(); i++)
+      targetFilter.push_back(LifeTarget<N>::Parse(params.targetFilter[i].c_str(),
+                                               params.filterdx[i], params.filterdy[i]));
+
+    alsoRequired = LifeState<N>::Parse(params.alsoRequired.c_str(), params.alsoRequiredXY.first, params.alsoRequiredXY.second);
+
+    found = 0;
+    fullfound = 0;
+
+    hasFilter = !params.targetFilter.empty();
+    reportAll = params.fullReportFile.length() != 0;
+
+    filterMaxGen = FilterMaxGen();
+    CompileFilters();
+
+    ComputeBaseEvolution();
+  }
+
+  void GroupPlacementKernels() {
+    // The first mask of each group, its kernel and its offset
+    std::vector<LifeState<N>> canonical;
+    std::vector<const LifeKernel<N> *> groupKernels;
+    std::vector<std::pair<int, int>> groupOffsets;
+    auto group = [&](const LifeState<N> &mask, const LifeKernel<N> &kernel,
+                     std::pair<int, int> &offset) {
+      std::array<int, 4> bounds = mask.XYBounds();
+      LifeState<N> moved = mask;
+      moved.Move(-bounds[0], -bounds[1]);
+      for (unsigned g = 0; g < canonical.size(); g++) {
+        if (canonical[g] == moved) {
+          offset = std::make_pair(bounds[0] - groupOffsets[g].first,
+                                  bounds[1] - groupOffsets[g].second);
+          return g;
+        }
+      }
+      canonical.push_back(moved);
+      groupKernels.push_back(&kernel);
+      groupOffsets.push_back(std::make_pair(bounds[0], bounds[1]));
+      offset = std::make_pair(0, 0);
+      return (unsigned)canonical.size() - 1;
+    };
+
+    std::vector<unsigned> reactionGroups(catalysts.size());
+    std::vector<int> avoidGroups(catalysts.size(), -1);
+    reactionOffsets.assign(catalysts.size(), std::make_pair(0, 0));
+    avoidOffsets.assign(catalysts.size(), std::make_pair(0, 0));
+    for (unsigned s = 0; s < catalysts.size(); s++) {
+      reactionGroups[s] = group(catalysts[s].locusReactionMask, catalysts[s].locusReactionKernel,
+                                reactionOffsets[s]);
+      if (catalysts[s].hasLocus)
+        avoidGroups[s] = group(catalysts[s].locusAvoidMask, catalysts[s].locusAvoidKernel,
+                               avoidOffsets[s]);
+    }
+
+    for (unsigned noTransparent = 0; noTransparent < 2; noTransparent++) {
+      for (unsigned onlyMustInclude = 0; onlyMustInclude < 2; onlyMustInclude++) {
+        PlacementKernels &placement = placementKernels[noTransparent][onlyMustInclude];
+        std::vector<int> slots(canonical.size(), -1);
+        auto slot = [&](unsigned g) {
+          if (slots[g] == -1) {
+            slots[g] = placement.kernels.size();
+            placement.kernels.push_back(groupKernels[g]);
+          }
+          return slots[g];
+        };
+
+        placement.reactionSlot.assign(catalysts.size(), -1);
+        placement.avoidSlot.assign(catalysts.size(), -1);
+        for (unsigned s = 0; s < catalysts.size(); s++) {
+          if (avoidGroups[s] != -1)
+            placement.avoidSlot[s] = slot(avoidGroups[s]);
+          if ((noTransparent && catalysts[s].transparent) ||
+              (onlyMustInclude && !catalysts[s].mustInclude))
+            continue;
+          placement.reactionSlot[s] = slot(reactionGroups[s]);
+        }
+      }
+    }
+
+    unsigned distinct = std::set<unsigned>(reactionGroups.begin(), reactionGroups.end()).size();
+    if (distinct < catalysts.size())
+      std::cout << "The " << catalysts.size() << " catalysts share " << distinct
+                << " distinct reaction masks" << std::endl;
+  }
+
+  void CompileFilters() {
+    filterSchedule.assign(filterMaxGen + 1, std::vector<unsigned>());
+    for (unsigned k = 0; k < targetFilter.size(); k++) {
+      for (unsigned g = 0; g <= filterMaxGen; g++) {
+        bool inSingle = params.filterGen[k] == (int)g;
+        bool inRange = params.filterGen[k] == -1 &&
+                       params.filterGenRange[k].first <= (int)g &&
+                       params.filterGenRange[k].second >= (int)g;
+        if (inSingle || inRange)
+          filterSchedule[g].push_back(k);
+      }
+    }
+
+    filterMatchers.assign(targetFilter.size(), std::vector<LifeMatcher<N>>());
+    for (unsigned k = 0; k < targetFilter.size(); k++) {
+      if (params.filterType[k] != MATCHFILTER)
+        continue;
+      for (auto sym : SymmetryGroupFromEnum(StaticSymmetry::D8)) {
+        LifeTarget<N> transformed = targetFilter[k];
+        transformed.Transform(sym);
+        filterMatchers[k].push_back(LifeMatcher<N>(transformed));
+      }
+    }
+  }
+
+  void ComputeBaseEvolution() {
+    LifeState<N> workspace;
+    workspace.JoinWSymChain(pat, params.symmetryChain);
+
+    baseEvolution.clear();
+    baseReach.clear();
+    LifeState<N> reach;
+    for (unsigned g = 0; g <= filterMaxGen + 1; g++) {
+      baseEvolution.push_back(workspace);
+      baseReach.push_back(reach);
+      reach |= workspace.ZOI().ZOI();
+      workspace.Step();
+    }
+
+    unsigned startGen = std::min((unsigned)params.startGen, filterMaxGen);
+    startGenBlocking = std::vector<LifeState<N>>(catalysts.size());
+    for (unsigned g = 0; g < startGen; g++)
+      for (unsigned s = 0; s < catalysts.size(); s++)
+        startGenBlocking[s] |= baseEvolution[g].Convolve(catalysts[s].reactionKernel);
+  }
+
+  // The last generation up to which the board with these catalysts is
+  // just the catalyst-free evolution plus the catalysts
+  unsigned QuietUntil(const LifeState<N> &cats) const {
+    LifeState<N> stepped = cats;
+    stepped.Step();
+    if (stepped != cats)
+      return 0;
+
+    // baseReach only grows, so search for the last disjoint entry
+    unsigned lo = 0;
+    unsigned hi = baseReach.size() - 1;
+    while (lo < hi) {
+      unsigned mid = (lo + hi + 1) / 2;
+      if (cats.AreDisjoint(baseReach[mid]))
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+    return lo;
+  }
+
+  double ElapsedSeconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  }
+
+  unsigned FilterMaxGen() {
+    unsigned maxGen = params.maxGen;
+
+    for (unsigned j = 0; j < targetFilter.size(); j++) {
+      if (params.filterGen[j] >= 0 && params.filterGen[j] > maxGen)
+        maxGen = params.filterGen[j];
+
+      if (params.filterGenRange[j].second >= 0 && params.filterGenRange[j].second > maxGen)
+        maxGen = params.filterGenRange[j].second;
+    }
+
+    return maxGen;
+  }
+
+  // Prints the counts and streams out the new results. The full output
+  // is only written by Save, or here once SIGUSR1 has asked for it.
+  void Report() {
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    unsigned sec = ElapsedSeconds() + 1;
+
+    std::cout << "results: " << categoryContainer->categories.size() << "/"
+              << found;
+    if (params.fullReportFile.length() != 0) {
+      std::cout << ", unfiltered: " << fullCategoryContainer->categories.size() << "/"
+                << fullfound;
+    }
+    std::cout << ", now: ";
+    PrintTime(sec);
+    std::cout << std::endl;
+    PrintStats(false);
+    fflush(stdout);
+
+    if (resultStream.is_open()) {
+      resultStream << categoryContainer->StreamRecords() << std::flush;
+      if (reportAll)
+        fullResultStream << fullCategoryContainer->StreamRecords() << std::flush;
+    }
+
+    if (saveRequested) {
+      saveRequested = 0;
+      SaveAll();
+    }
+  }
+
+  void Save() {
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    SaveAll();
+  }
+
+  void SaveAll() const {
+    if (pool != nullptr) {
+      // Workers add results in whatever order they finish, and that
+      // order decides the categories, so save them as a single thread
+      // would have found them
+      CategoryContainer<N> ordered(params.maxGen);
+      Reorder(*categoryContainer, ordered);
+      SaveResults(params.outputFile, ordered, shardCount > 1);
+
+      if (params.fullReportFile.length() != 0) {
+        CategoryContainer<N> fullOrdered(params.maxGen);
+        Reorder(*fullCategoryContainer, fullOrdered);
+        SaveResults(params.fullReportFile, fullOrdered, shardCount > 1);
+      }
+      return;
+    }
+
+    SaveResults(params.outputFile, *categoryContainer, shardCount > 1);
+
+    if (params.fullReportFile.length() != 0)
+      SaveResults(params.fullReportFile, *fullCategoryContainer, shardCount > 1);
+  }
+
+  // Adds the results of from to the empty container to in the order of
+  // their paths. Results restored from a checkpoint only know their
+  // branch, and keep the order they were added in.
+  void Reorder(const CategoryContainer<N> &from, CategoryContainer<N> &to) const {
+    std::vector<SearchResult<N>> results;
+    for (auto &category : from.categories)
+      results.insert(results.end(), category->results.begin(), category->results.end());
+
+    std::stable_sort(results.begin(), results.end(),
+                     [](const SearchResult<N> &a, const SearchResult<N> &b) {
+                       return a.path < b.path || (a.path == b.path && a.seq < b.seq);
+                     });
+
+    unsigned count = 0;
+    for (auto &result : results) {
+      Configuration<N> conf;
+      conf.branch = result.branch;
+      conf.path = result.path;
+      RestoreResult(result.init, conf, result.firstGenSurvive, result.maxGenSurvive, to, count);
+    }
+  }
+
+  // Truncates the streams, which hold the results of this run
+  void OpenStreams() {
+    resultStream.open((params.outputFile + ".stream").c_str(), std::ios::trunc);
+    resultStream << "#C CatForce results " << N << "\n";
+    if (reportAll) {
+      fullResultStream.open((params.fullReportFile + ".stream").c_str(), std::ios::trunc);
+      fullResultStream << "#C CatForce results " << N << "\n";
+    }
+  }
+
+  void SaveResults(const std::string &fname, CategoryContainer<N> &container,
+                   bool withComments) const {
+    std::cout << "Saving " << fname << "... " << std::flush;
+
+    std::ofstream resultsFile(fname.c_str());
+    if (withComments) {
+      resultsFile << "#C CatForce shard " << shardIndex << "/" << shardCount << "\n";
+      resultsFile << container.ResultsComments(params.maxCatSize);
+    }
+    resultsFile << "x = 0, y = 0, rule = B3/S23\n";
+    resultsFile << container.CategoriesRLE(params.maxCatSize);
+    resultsFile.close();
+    std::cout << "Done!" << std::endl;
+  }
+
+  // Re-categorize the results of every shard of this input file as if
+  // they had been found by a single search.
+  void Merge(unsigned numShards) {
+    MergeShards(params.outputFile, numShards, *categoryContainer, found);
+    if (reportAll)
+      MergeShards(params.fullReportFile, numShards, *fullCategoryContainer, fullfound);
+
+    Report();
+    Save();
+  }
+
+  void MergeShards(const std::string &fname, unsigned numShards,
+                   CategoryContainer<N> &container, unsigned &count) {
+    std::vector<SearchResult<N>> results;
+    for (unsigned i = 0; i < numShards; i++) {
+      std::string shardName = ShardFileName(fname, i, numShards);
+      std::ifstream infile(shardName.c_str());
+      if (!infile.good()) {
+        std::cout << "Could not open shard " << shardName << std::endl;
+        exit(1);
+      }
+
+      std::vector<std::string> comments;
+      std::map<std::pair<unsigned, unsigned>, LifeState<N>> tiles =
+          ParseResultTiles<N>(infile, comments);
+
+      unsigned merged = 0;
+      for (auto &comment : comments) {
+        std::vector<std::string> elems = splitwhitespace(comment);
+        if (elems.size() != 8 || elems[1] != "result")
+          continue;
+
+        std::pair<unsigned, unsigned> key(atoi(elems[2].c_str()), atoi(elems[3].c_str()));
+        Configuration<N> conf;
+        conf.branch = strtoull(elems[6].c_str(), nullptr, 10);
+        SearchResult<N> result(tiles[key], conf, atoi(elems[4].c_str()), atoi(elems[5].c_str()));
+        result.seq = atoi(elems[7].c_str());
+        results.push_back(result);
+        merged++;
+      }
+
+      std::cout << "Read " << merged << " results from " << shardName << std::endl;
+    }
+
+    // Categories depend on the order results arrive in, so replay them in
+    // the order a single unsharded search would have found them.
+    std::stable_sort(results.begin(), results.end(),
+                     [](const SearchResult<N> &a, const SearchResult<N> &b) {
+                       return a.branch < b.branch || (a.branch == b.branch && a.seq < b.seq);
+                     });
+
+    for (auto &result : results)
+      RestoreResult(result.init, result.branch, result.firstGenSurvive,
+                    result.maxGenSurvive, container, count);
+  }
+
+  // Add a result that was saved as its starting board only
+  void RestoreResult(LifeState<N> &init, uint64_t branch, unsigned firstGenSurvive,
+                     unsigned maxGenSurvive, CategoryContainer<N> &container, unsigned &count) const {
+    Configuration<N> conf;
+    conf.branch = branch;
+    conf.path[0] = branch;
+    RestoreResult(init, conf, firstGenSurvive, maxGenSurvive, container, count);
+  }
+
+  void RestoreResult(LifeState<N> &init, const Configuration<N> &conf, unsigned firstGenSurvive,
+                     unsigned maxGenSurvive, CategoryContainer<N> &container, unsigned &count) const {
+    // Catalysts never touch the active pattern at gen 0, so the board
+    // splits back into the two parts it was built from.
+    LifeState<N> patSym;
+    patSym.JoinWSymChain(pat, params.symmetryChain);
+
+    LifeState<N> catalysts = init & ~patSym;
+    LifeState<N> afterCatalyst = init;
+    afterCatalyst.Step(firstGenSurvive);
+
+    container.Add(init, afterCatalyst, catalysts, conf, firstGenSurvive, maxGenSurvive);
+    count++;
+  }
+
+  static void PrintTime(unsigned sec) {
+    unsigned hr = sec / 3600;
+    unsigned min = (sec / 60) - hr * 60;
+    unsigned secs = sec - 3600 * hr - 60 * min;
+    std::cout << std::setfill('0');
+    std::cout << hr << ":" << std::setw(2) << min << ":" << std::setw(2) << secs;
+ }
+
+  bool HasForbidden(Configuration<N> &conf, unsigned curIter, Replay<N> &replay) {
+    for (unsigned i = 0; i <= curIter + 1; i++) {
+      const LifeState<N> &workspace = replay.At(i);
+      for (unsigned j = 0; j < params.numCatalysts; j++) {
+        for (unsigned k = 0; k < catalysts[conf.curs[j]].forbidden.size(); k++) {
+          if (workspace.Contains(catalysts[conf.curs[j]].forbidden[k], conf.curx[j], conf.cury[j]))
+            return true;
+        }
+      }
+    }
+
+    return false;
+  }
+
+  // Find a forbidden pattern of a placed catalyst on the board now, only
+  // looking around each catalyst
+  bool MatchForbidden(Configuration<N> &config) const {
+    for (unsigned j = 0; j < config.count; j++) {
+      const std::vector<LifeTarget<N>> &forbidden = catalysts[config.curs[j]].forbidden;
+      for (unsigned k = 0; k < forbidden.size(); k++) {
+        if (config.state.Contains(forbidden[k], config.curx[j], config.cury[j])) {
+          config.forbiddenCatalyst = j;
+          config.forbiddenIndex = k;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  bool FilterForCurrentGenFail(LifeState<N> &workspace) {
+    for (unsigned j = 0; j < targetFilter.size(); j++) {
+      if (workspace.gen == params.filterGen[j] &&
+          workspace.Contains(targetFilter[j]) == false) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool ValidateFilters(Configuration<N> &conf, unsigned successtime, unsigned failuretime,
+                       Replay<N> &replay) {
     unsigned maxMatchingPop;
     if(params.maxJunk != -1)
-      maxMatchingPop = workspace.GetPop() + params.maxJunk;
+      maxMatchingPop = replay.At(0).GetPop() + params.maxJunk;
     else
       maxMatchingPop = 10000;
 
@@ -1255,18 +3040,27 @@ public:
       stopTime = filterMaxGen;
 
     for (unsigned g = 0; g <= std::min(filterMaxGen, stopTime); g++) {
-      for (unsigned k = 0; k < params.filterGen.size(); k++) {
+      const LifeState<N> &workspace = replay.At(g);
+
+      // Once the board cycles, a range filter checked a period ago gets
+      // the same answer again
+      unsigned period = replay.Period();
+      bool settled = replay.Repeats(g) && g - period + params.stableInterval >= successtime;
+
+      for (unsigned k : filterSchedule[g]) {
         if (filterPassed[k])
           continue; // No need to check it again.
 
+        // Filters over a range only count once every catalyst has
+        // interacted
         bool inSingle = workspace.gen == params.filterGen[k];
-        bool inRange = params.filterGen[k] == -1 &&
-                       params.filterGenRange[k].first <= workspace.gen &&
-                       params.filterGenRange[k].second >= workspace.gen;
-        bool shouldCheck = inSingle || (inRange && workspace.gen + params.stableInterval >= successtime);
+        bool shouldCheck = inSingle || workspace.gen + params.stableInterval >= successtime;
+
+        if (!inSingle && settled && params.filterGenRange[k].first <= (int)(g - period))
+          continue;
 
         bool succeeded = false;
-        LifeState junk;
+        LifeState<N> junk;
 
         // See whether there is a match at all
         if (shouldCheck && (params.filterType[k] == ANDFILTER ||
@@ -1277,16 +3071,12 @@ public:
 
         if (shouldCheck && (params.filterType[k] == MATCHFILTER)) {
           if(workspace.GetPop() <= maxMatchingPop) {
-            LifeState withoutCatalysts = workspace & ~conf.startingCatalysts;
-            for (auto sym : SymmetryGroupFromEnum(StaticSymmetry::D8)) {
-              LifeTarget transformed = targetFilter[k];
-              transformed.Transform(sym);
-              LifeState matches = withoutCatalysts.Match(transformed);
-              if(!matches.IsEmpty()) {
-                succeeded = true;
-                junk = withoutCatalysts & ~matches.Convolve(transformed.wanted);
-                break;
-              }
+            LifeState<N> withoutCatalysts = workspace & ~conf.startingCatalysts;
+            LifeState<N> matches;
+            int which = withoutCatalysts.MatchFirst(filterMatchers[k], matches);
+            if (which != -1) {
+              succeeded = true;
+              junk = withoutCatalysts & ~matches.Convolve(filterMatchers[k][which].wanted);
             }
           }
         }
@@ -1313,7 +3103,20 @@ public:
           return false;
       }
 
-      workspace.Step();
+      if (settled) {
+        // Stop once no later generation can pass another filter
+        bool undecided = false;
+        for (unsigned k = 0; k < params.filterGen.size(); k++) {
+          if (filterPassed[k])
+            continue;
+          if (params.filterGen[k] != -1 ? params.filterGen[k] > (int)g
+                                        : params.filterGenRange[k].second > (int)g &&
+                                              params.filterGenRange[k].first > (int)(g - period))
+            undecided = true;
+        }
+        if (!undecided)
+          break;
+      }
     }
 
     for (unsigned k = 0; k < params.filterGen.size(); k++)
@@ -1323,141 +3126,303 @@ public:
     return true;
   }
 
-  void ReportSolution(Configuration &conf, unsigned successtime, unsigned failuretime) {
-    if (HasForbidden(conf, successtime + 3))
+  void ReportSolution(Configuration<N> &conf, unsigned successtime, unsigned failuretime) {
+    SearchStats &localStats = LocalStats();
+    // Every check below looks at the same generations, so they are only
+    // simulated once
+    Replay<N> &replay = LocalReplay();
+    replay.Start(conf.startingCatalysts, QuietUntil(conf.startingCatalysts), baseEvolution);
+
+    if (HasForbidden(conf, successtime + 3, replay)) {
+      localStats.Add(SearchStats::FORBIDDEN, conf.count);
       return;
+    }
 
     // if reportAll - ignore filters and update fullReport
     if (reportAll) {
-      LifeState workspace = conf.startingCatalysts;
-      workspace.JoinWSymChain(pat, params.symmetryChain);
-
-      LifeState init = workspace;
-
-      workspace.Step(successtime - params.stableInterval + 2);
-      LifeState afterCatalyst = workspace;
+      LifeState<N> init = replay.At(0);
+      const LifeState<N> &afterCatalyst = replay.At(successtime - params.stableInterval + 2);
 
+      std::lock_guard<std::mutex> lock(resultsMutex);
       fullfound++;
 
       fullCategoryContainer->Add(init, afterCatalyst, conf.startingCatalysts, conf,
                                  successtime - params.stableInterval + 2, 0);
+      if (checkpoint != nullptr)
+        checkpoint->AddResult(conf.branch, true, init, successtime - params.stableInterval + 2, 0);
     }
 
     // If has filter validate them;
     if (hasFilter) {
-      if (!ValidateFilters(conf, successtime, failuretime))
+      if (!ValidateFilters(conf, successtime, failuretime, replay)) {
+        localStats.Add(SearchStats::FILTERED, conf.count);
         return;
+      }
     }
 
     // If all filters validated update results
-    LifeState workspace = conf.startingCatalysts;
-    workspace.JoinWSymChain(pat, params.symmetryChain);
-
-    LifeState init = workspace;
-
-    workspace.Step(successtime - params.stableInterval + 2);
-
-    LifeState afterCatalyst = workspace;
+    LifeState<N> init = replay.At(0);
+    const LifeState<N> &afterCatalyst = replay.At(successtime - params.stableInterval + 2);
 
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    size_t categories = categoryContainer->categories.size();
     categoryContainer->Add(init, afterCatalyst, conf.startingCatalysts, conf,
                            successtime - params.stableInterval + 2, 0);
+    localStats.Add(SearchStats::CATEGORIES, conf.count,
+                   categoryContainer->categories.size() - categories);
     found++;
+    if (checkpoint != nullptr)
+      checkpoint->AddResult(conf.branch, false, init, successtime - params.stableInterval + 2, 0);
   }
 
   void Search() {
-    Configuration config;
+    Configuration<N> config;
     config.count = 0;
     config.transparentCount = 0;
     config.mustIncludeCount = 0;
-    config.state.JoinWSymChain(pat, params.symmetryChain);
+    config.branch = 0;
+    config.state = baseEvolution[0];
 
-    LifeState bounds =
-        LifeState::SolidRect(params.searchArea[0], params.searchArea[1],
+    LifeState<N> bounds =
+        LifeState<N>::SolidRect(params.searchArea[0], params.searchArea[1],
                              params.searchArea[2], params.searchArea[3]);
 
-    bounds &= FundamentalDomain(params.symmetry);
+    bounds &= FundamentalDomain<N>(params.symmetry);
 
-    std::vector<LifeState> masks(catalysts.size());
+    LifeState<N> *masks = LocalArena().Frame(0);
     for (unsigned s = 0; s < catalysts.size(); s++) {
-      LifeState zoi = catalysts[s].state.ZOI();
+      LifeState<N> zoi = catalysts[s].state.ZOI();
       zoi.Transform(Rotate180OddBoth);
-      masks[s] = config.state.Convolve(zoi) | ~bounds;
+      masks[s] = config.state.Convolve(zoi) | ~bounds | startGenBlocking[s];
     }
 
-    std::vector<LifeTarget> shiftedTargets(params.numCatalysts);
+    // Nothing can be placed before start-gen, so begin there
+    config.state = baseEvolution[std::min((unsigned)params.startGen, filterMaxGen)];
+
+    std::vector<LifeTarget<N>> shiftedTargets(params.numCatalysts);
 
-    RecursiveSearch(config, config.state, alsoRequired, LifeState(), masks, shiftedTargets,
+    RecursiveSearch(config, baseEvolution[0], alsoRequired, LifeState<N>(), masks, shiftedTargets,
                     std::array<unsigned, MAX_CATALYSTS>(), std::array<unsigned, MAX_CATALYSTS>());
+
+    if (pool != nullptr) {
+      pool->Wait();
+      Report();
+    }
+    Save();
+
+    if (checkpoint != nullptr)
+      checkpoint->Finish();
+  }
+
+  // Hand a subtree to the pool. The task owns copies of everything the
+  // recursion mutates, including the per-depth shiftedTargets.
+  void SpawnSearch(const Configuration<N> &config, const LifeState<N> &history,
+                   const LifeState<N> &required, const LifeState<N> &antirequired,
+                   const LifeState<N> *masks,
+                   const std::vector<LifeTarget<N>> &shiftedTargets,
+                   const std::array<unsigned, MAX_CATALYSTS> &missingTime,
+                   const std::array<unsigned, MAX_CATALYSTS> &recoveredTime) {
+    struct SearchTask {
+      Configuration<N> config;
+      LifeState<N> history;
+      LifeState<N> required;
+      LifeState<N> antirequired;
+      std::vector<LifeState<N>> masks;
+      std::vector<LifeTarget<N>> shiftedTargets;
+      std::array<unsigned, MAX_CATALYSTS> missingTime;
+      std::array<unsigned, MAX_CATALYSTS> recoveredTime;
+    };
+
+    std::shared_ptr<SearchTask> task(new SearchTask{
+        config, history, required, antirequired,
+        std::vector<LifeState<N>>(masks, masks + catalysts.size()),
+        shiftedTargets, missingTime, recoveredTime});
+    if (checkpoint != nullptr)
+      checkpoint->Retain(config.branch);
+    pool->Submit([this, task] {
+      RecursiveSearch(task->config, task->history, task->required, task->antirequired,
+                      task->masks.data(), task->shiftedTargets, task->missingTime,
+                      task->recoveredTime);
+      if (checkpoint != nullptr)
+        checkpoint->Release(task->config.branch);
+    });
+  }
+
+  // Run the interaction, required/antirequired and recovery lookaheads
+  // for every placement in the batch at once
+  void EvaluatePlacements(const Configuration<N> &config, unsigned s,
+                          const LifeState<N> &next, const LifeState<N> &required,
+                          const LifeState<N> &antirequired, PlacementBatch<N> &batch) {
+    const CatalystData<N> &catalyst = catalysts[s];
+
+    LifeStateBatch<N> boards;
+    std::array<LifeState<N>, LifeStateBatch<N>::Lanes> expected;
+    for (unsigned c = 0; c < batch.size; c++) {
+      int x = batch.placements[c].first;
+      int y = batch.placements[c].second;
+
+      batch.shiftedCatalyst[c] = catalyst.state;
+      batch.shiftedCatalyst[c].Move(x, y);
+
+      batch.symCatalyst[c] = LifeState<N>();
+      batch.symCatalyst[c].JoinWSymChain(batch.shiftedCatalyst[c], params.symmetryChain);
+
+      boards.Set(c, config.state | batch.symCatalyst[c]);
+      // What the board becomes if the catalyst is left alone
+      expected[c] = next ^ batch.symCatalyst[c];
+      batch.verdict[c] = PLACEMENT_OK;
+    }
+
+    unsigned recoveryGen = catalyst.checkRecovery ? catalyst.maxDisappear : 0;
+    unsigned horizon = std::max(4U, recoveryGen);
+
+    unsigned undecided = batch.size;
+    std::array<bool, LifeStateBatch<N>::Lanes> recovered;
+    recovered.fill(true);
+
+    for (unsigned g = 0; g <= horizon && undecided > 0; g++) {
+      if (g > 0)
+        boards.Step();
+
+      for (unsigned c = 0; c < batch.size; c++) {
+        if (batch.verdict[c] != PLACEMENT_OK)
+          continue;
+
+        if (g == 1 && boards.Equals(c, expected[c])) {
+          batch.verdict[c] = PLACEMENT_NO_INTERACTION;
+          undecided--;
+          continue;
+        }
+        if (g == 4) {
+          // Only needed for the placements that interact
+          int x = batch.placements[c].first;
+          int y = batch.placements[c].second;
+          batch.required[c] = required;
+          batch.required[c].Join(catalyst.required, x, y);
+          batch.antirequired[c] = antirequired;
+          batch.antirequired[c].Join(catalyst.antirequired, x, y);
+
+          if (!boards.Contains(c, batch.required[c]) ||
+              !boards.AreDisjoint(c, batch.antirequired[c])) {
+            batch.verdict[c] = PLACEMENT_DESTROYED;
+            undecided--;
+            continue;
+          }
+        }
+        if (catalyst.checkRecovery && g == recoveryGen)
+          recovered[c] = boards.Contains(c, batch.shiftedCatalyst[c]);
+        if (g == horizon) {
+          if (!recovered[c])
+            batch.verdict[c] = PLACEMENT_NOT_RECOVERED;
+          undecided--;
+        }
+      }
+    }
   }
 
   void
-  TryAddingCatalyst(Configuration &config, LifeState &history,
-                 const LifeState &required, const LifeState &antirequired,
-                 std::vector<LifeState> &masks,
-                 std::vector<LifeTarget> &shiftedTargets, // This can be shared
+  TryAddingCatalyst(Configuration<N> &config, LifeState<N> &history,
+                 const LifeState<N> &required, const LifeState<N> &antirequired,
+                 LifeState<N> *masks,
+                 std::vector<LifeTarget<N>> &shiftedTargets, // This can be shared
 
                  std::array<unsigned, MAX_CATALYSTS> &missingTime,
                  std::array<unsigned, MAX_CATALYSTS> &recoveredTime) {
 
-    LifeState activePart =
+    LifeState<N> activePart =
         (~history).ZOI() & config.state & ~config.startingCatalysts;
 
+    // Until the first catalyst is placed the board is the catalyst-free
+    // evolution
+    LifeState<N> next;
+    if (config.count == 0)
+      next = baseEvolution[config.state.gen + 1];
+    else {
+      next = config.state;
+      next.Step();
+    }
+
     if (activePart.IsEmpty()) {
       history |= config.state;
-      config.state.Step();
+      config.state = next;
       return;
     }
 
-    LifeState next = config.state;
-    next.Step();
+    // Every mask convolved at once, see GroupPlacementKernels
+    const PlacementKernels &placement =
+        placementKernels[config.transparentCount == params.numTransparent]
+                        [config.count == params.numCatalysts - 1 && config.mustIncludeCount == 0];
+    LifeState<N> *convolved = LocalConvolutionArena().Frame(config.count);
+    activePart.Convolve(placement.kernels.data(), placement.kernels.size(), convolved);
 
     for (unsigned s = 0; s < catalysts.size(); s++) {
-      if (catalysts[s].hasLocus) {
-        LifeState hitLocations = activePart.Convolve(catalysts[s].locusAvoidMask);
+      if (placement.avoidSlot[s] != -1) {
+        LifeState<N> hitLocations = convolved[placement.avoidSlot[s]];
+        if (avoidOffsets[s] != std::make_pair(0, 0))
+          hitLocations.Move(avoidOffsets[s].first, avoidOffsets[s].second);
         masks[s] |= hitLocations;
       }
     }
 
+    SearchStats &localStats = LocalStats();
     for (unsigned s = 0; s < catalysts.size(); s++) {
-      if (config.transparentCount == params.numTransparent &&
-          catalysts[s].transparent)
-        continue;
-      if (config.count == params.numCatalysts - 1 &&
-          config.mustIncludeCount == 0 && !catalysts[s].mustInclude)
+      if (placement.reactionSlot[s] == -1)
         continue;
 
-      LifeState newPlacements =
-          activePart.Convolve(catalysts[s].locusReactionMask) & ~masks[s];
+      LifeState<N> newPlacements = convolved[placement.reactionSlot[s]];
+      if (reactionOffsets[s] != std::make_pair(0, 0))
+        newPlacements.Move(reactionOffsets[s].first, reactionOffsets[s].second);
+      newPlacements &= ~masks[s];
+      if (newPlacements.IsEmpty())
+        continue;
 
+      PlacementBatch<N> batch;
       while (!newPlacements.IsEmpty()) {
-        // Do the placement
-        auto newPlacement = newPlacements.FirstOn();
-
-        Configuration newConfig = config;
-        newConfig.count += 1;
-        newConfig.curx[config.count] = newPlacement.first;
-        newConfig.cury[config.count] = newPlacement.second;
-        newConfig.curs[config.count] = s;
-        if (catalysts[s].transparent)
-          newConfig.transparentCount++;
-        if (catalysts[s].mustInclude)
-          newConfig.mustIncludeCount++;
-
-        LifeState shiftedCatalyst = catalysts[s].state;
-        shiftedCatalyst.Move(newPlacement.first, newPlacement.second);
-
-        LifeState symCatalyst;
-        symCatalyst.JoinWSymChain(shiftedCatalyst, params.symmetryChain);
-        newConfig.startingCatalysts |= symCatalyst;
-        newConfig.state |= symCatalyst;
-
-        // Do a one-step lookahead to see if the catalyst interacts
-        {
-          LifeState newnext = newConfig.state;
-          newnext.Step();
+        batch.size = 0;
+        while (batch.size < LifeStateBatch<N>::Lanes && !newPlacements.IsEmpty()) {
+          auto placement = newPlacements.FirstOn();
+          batch.placements[batch.size++] = placement;
+          newPlacements.Erase(placement.first, placement.second);
+        }
+        EvaluatePlacements(config, s, next, required, antirequired, batch);
+        localStats.Add(SearchStats::PLACEMENTS, config.count, batch.size);
+
+        for (unsigned c = 0; c < batch.size; c++) {
+          // Do the placement
+          auto newPlacement = batch.placements[c];
+
+          Configuration<N> newConfig = config;
+          newConfig.count += 1;
+          newConfig.curx[config.count] = newPlacement.first;
+          newConfig.cury[config.count] = newPlacement.second;
+          newConfig.curs[config.count] = s;
+          newConfig.path[config.count] =
+              BranchKey(config.state.gen, s, newPlacement.first, newPlacement.second);
+          if (config.count == 0)
+            newConfig.branch = newConfig.path[0];
+          if (catalysts[s].transparent)
+            newConfig.transparentCount++;
+          if (catalysts[s].mustInclude)
+            newConfig.mustIncludeCount++;
+
+          const LifeState<N> &shiftedCatalyst = batch.shiftedCatalyst[c];
+          const LifeState<N> &symCatalyst = batch.symCatalyst[c];
+          newConfig.startingCatalysts |= symCatalyst;
+          newConfig.state |= symCatalyst;
+
+          // The new catalyst is on the board for the whole replay, and
+          // covering an unwanted cell spoils the forbidden match
+          if (newConfig.forbiddenCatalyst != -1) {
+            int j = newConfig.forbiddenCatalyst;
+            const LifeTarget<N> &forbidden =
+                catalysts[newConfig.curs[j]].forbidden[newConfig.forbiddenIndex];
+            if (!symCatalyst.AreDisjoint(forbidden.unwanted, newConfig.curx[j], newConfig.cury[j]))
+              newConfig.forbiddenCatalyst = -1;
+          }
 
-          LifeState difference = newnext ^ next ^ symCatalyst;
-          if (difference.IsEmpty()) {
+          // The one-step lookahead saw no interaction
+          if (batch.verdict[c] == PLACEMENT_NO_INTERACTION) {
+            localStats.Add(SearchStats::NO_INTERACTION, config.count);
             if (config.count == 0) {
               std::cout << "Skipping catalyst " << s << " at "
                         << newPlacement.first << ", " << newPlacement.second
@@ -1467,27 +3432,14 @@ public:
             // Note: we deliberately don't set the mask,
             // because it may turn out that a catalyst here
             // interacts properly in a later generation.
-            newPlacements.Erase(newPlacement.first, newPlacement.second);
             continue;
           }
-        }
 
-        LifeState newRequired = required;
-        newRequired.Join(catalysts[s].required, newPlacement.first,
-                         newPlacement.second);
+          const LifeState<N> &newRequired = batch.required[c];
+          const LifeState<N> &newAntirequired = batch.antirequired[c];
 
-        LifeState newAntirequired = antirequired;
-        newAntirequired.Join(catalysts[s].antirequired, newPlacement.first,
-                             newPlacement.second);
-
-        {
-          LifeState lookahead = newConfig.state;
-          lookahead.Step();
-          lookahead.Step();
-          lookahead.Step();
-          lookahead.Step();
-          if (!lookahead.Contains(newRequired) ||
-              !lookahead.AreDisjoint(newAntirequired)) {
+          if (batch.verdict[c] == PLACEMENT_DESTROYED) {
+            localStats.Add(SearchStats::DESTROYED, config.count);
             if (config.count == 0) {
               std::cout << "Skipping catalyst " << s << " at "
                         << newPlacement.first << ", " << newPlacement.second
@@ -1495,17 +3447,11 @@ public:
             }
 
             masks[s].Set(newPlacement.first, newPlacement.second);
-            newPlacements.Erase(newPlacement.first, newPlacement.second);
             continue;
           }
-        }
 
-        if (catalysts[s].checkRecovery) {
-          LifeState lookahead = newConfig.state;
-          for (unsigned i = 0; i < catalysts[s].maxDisappear; i++) {
-            lookahead.Step();
-          }
-          if (!lookahead.Contains(shiftedCatalyst)) {
+          if (batch.verdict[c] == PLACEMENT_NOT_RECOVERED) {
+            localStats.Add(SearchStats::NOT_RECOVERED, config.count);
             if (config.count == 0) {
               std::cout << "Skipping catalyst " << s << " at "
                         << newPlacement.first << ", " << newPlacement.second
@@ -1513,51 +3459,92 @@ public:
             }
 
             masks[s].Set(newPlacement.first, newPlacement.second);
-            newPlacements.Erase(newPlacement.first, newPlacement.second);
             continue;
           }
-        }
 
-        if (config.count == 0) {
-          std::cout
-              << "Placing catalyst " << s << " at " << newPlacement.first
-              << ", " << newPlacement.second << std::endl;
-        }
+          if (newConfig.count == params.numCatalysts && newConfig.forbiddenCatalyst != -1) {
+            // Every solution here contains the forbidden pattern
+            localStats.Add(SearchStats::FORBIDDEN, newConfig.count);
+            masks[s].Set(newPlacement.first, newPlacement.second);
+            continue;
+          }
+
+          if (config.count == 0 &&
+              !PlacementInShard(config.state.gen, s, newPlacement.first,
+                                newPlacement.second, shardIndex, shardCount)) {
+            // Another shard explores this branch
+            masks[s].Set(newPlacement.first, newPlacement.second);
+            continue;
+          }
+
+          if (config.count == 0 && checkpoint != nullptr &&
+              checkpoint->IsDone(newConfig.branch)) {
+            std::cout << "Skipping catalyst " << s << " at "
+                      << newPlacement.first << ", " << newPlacement.second
+                      << " (searched before resuming) " << std::endl;
+            masks[s].Set(newPlacement.first, newPlacement.second);
+            continue;
+          }
 
-        shiftedTargets[config.count].wanted = shiftedCatalyst;
-        shiftedTargets[config.count].unwanted = catalysts[s].target.unwanted;
-        shiftedTargets[config.count].unwanted.Move(newPlacement.first,
-                                                   newPlacement.second);
+          if (config.count == 0) {
+            std::cout
+                << "Placing catalyst " << s << " at " << newPlacement.first
+                << ", " << newPlacement.second << std::endl;
+          }
 
-        std::vector<LifeState> newMasks = masks;
+          shiftedTargets[config.count].wanted = shiftedCatalyst;
+          shiftedTargets[config.count].unwanted = catalysts[s].target.unwanted;
+          shiftedTargets[config.count].unwanted.Move(newPlacement.first,
+                                                     newPlacement.second);
 
-        // If we just placed the last catalyst, don't bother
-        // updating the masks
-        if (newConfig.count != params.numCatalysts) {
-          LifeState bounds;
-          if (params.maxW != -1) {
-            LifeState rect =
-                LifeState::SolidRect(newPlacement.first - params.maxW,
-                                     newPlacement.second - params.maxH,
-                                     2 * params.maxW - 1, 2 * params.maxH - 1);
-            bounds.JoinWSymChain(rect, params.symmetryChain);
+          // If we just placed the last catalyst, the masks are never
+          // looked at again, so the child can share ours
+          LifeState<N> *newMasks = masks;
+          if (newConfig.count != params.numCatalysts) {
+            newMasks = LocalArena().Frame(newConfig.count);
 
             for (unsigned t = 0; t < catalysts.size(); t++) {
-              newMasks[t] |= ~bounds;
+              auto mask = collisionMasks.Get(s * catalysts.size() + t);
+              if (mask.IsEmpty())
+                newMasks[t] = masks[t];
+              else
+                newMasks[t].JoinMoved(masks[t], mask.columns, mask.min, mask.width,
+                                      newPlacement.first, newPlacement.second);
             }
-          }
 
-          for (unsigned t = 0; t < catalysts.size(); t++) {
-            newMasks[t].Join(catalystCollisionMasks[s * catalysts.size() + t],
-                             newPlacement.first, newPlacement.second);
+            if (params.maxW != -1) {
+              LifeState<N> bounds;
+              LifeState<N> rect =
+                  LifeState<N>::SolidRect(newPlacement.first - params.maxW,
+                                       newPlacement.second - params.maxH,
+                                       2 * params.maxW - 1, 2 * params.maxH - 1);
+              bounds.JoinWSymChain(rect, params.symmetryChain);
+              LifeState<N> outside = ~bounds;
+
+              for (unsigned t = 0; t < catalysts.size(); t++) {
+                newMasks[t] |= outside;
+              }
+            }
           }
-        }
 
-        RecursiveSearch(newConfig, history, newRequired, newAntirequired,
+          // Every first-catalyst branch goes to the pool; deeper subtrees
+          // are split off only while some worker is starved for work.
+          if (pool != nullptr &&
+              (config.count == 0 ||
+               (newConfig.count != params.numCatalysts && pool->HasIdleWorker())))
+            SpawnSearch(newConfig, history, newRequired, newAntirequired,
                         newMasks, shiftedTargets, missingTime, recoveredTime);
+          else {
+            if (config.count == 0 && checkpoint != nullptr)
+              checkpoint->Retain(newConfig.branch);
+            RecursiveSearch(newConfig, history, newRequired, newAntirequired,
+                            newMasks, shiftedTargets, missingTime, recoveredTime);
+            if (config.count == 0 && checkpoint != nullptr)
+              checkpoint->Release(newConfig.branch);
+          }
 
-        masks[s].Set(newPlacement.first, newPlacement.second);
-        newPlacements.Erase(newPlacement.first, newPlacement.second);
+          masks[s].Set(newPlacement.first, newPlacement.second);
+        }
       }
     }
 
@@ -1565,29 +3552,85 @@ public:
     config.state = next;
   }
 
+  // Finish the loop of RecursiveSearch once every catalyst is placed and
+  // the board is the same as period generations before. Every board from
+  // then on has passed the checks at the top of the loop already, and the
+  // catalysts come and go in the same phases, so only the counts of how
+  // long each has been missing or recovered need following. Returns the
+  // generation the search fails at, or filterMaxGen.
+  unsigned FastForward(const Configuration<N> &config,
+                       const std::vector<LifeTarget<N>> &shiftedTargets,
+                       const CycleWatch<N> &cycleWatch, unsigned period,
+                       std::array<unsigned, MAX_CATALYSTS> missingTime,
+                       std::array<unsigned, MAX_CATALYSTS> recoveredTime,
+                       bool &success, unsigned &successtime) {
+    // Indexed by generations after the current one, mod period
+    bool present[Replay<N>::MaxPeriod][MAX_CATALYSTS];
+    for (unsigned q = 0; q < period; q++) {
+      const LifeState<N> &board = cycleWatch.Back(period - 1 - q);
+      for (unsigned i = 0; i < config.count; i++)
+        present[q][i] = board.Contains(shiftedTargets[i]) || catalysts[config.curs[i]].sacrificial;
+    }
+
+    unsigned gen = config.state.gen;
+    for (unsigned g = gen; g < filterMaxGen; g++) {
+      unsigned q = (g - gen) % period;
+      for (unsigned i = 0; i < config.count; i++) {
+        if (present[q][i]) {
+          missingTime[i] = 0;
+          recoveredTime[i] += 1;
+        } else {
+          missingTime[i] += 1;
+          recoveredTime[i] = 0;
+        }
+
+        if (missingTime[i] > catalysts[config.curs[i]].maxDisappear) {
+          LocalStats().Add(SearchStats::DISAPPEARED, config.count);
+          return g + 1;
+        }
+      }
+
+      if (!success) {
+        bool allRecovered = true;
+        for (unsigned i = 0; i < config.count; i++) {
+          if (catalysts[config.curs[i]].sacrificial)
+            continue;
+          if (recoveredTime[i] < params.stableInterval || missingTime[i] > 0)
+            allRecovered = false;
+        }
+        if (allRecovered) {
+          success = true;
+          successtime = g;
+        }
+      }
+    }
+    return filterMaxGen;
+  }
+
   void
-  RecursiveSearch(Configuration config, LifeState history, const LifeState required, const LifeState antirequired,
-                  std::vector<LifeState> masks,
-                  std::vector<LifeTarget> &shiftedTargets, // This can be shared
+  RecursiveSearch(Configuration<N> config, LifeState<N> history, const LifeState<N> required, const LifeState<N> antirequired,
+                  LifeState<N> *masks, // Owned by this node, see MaskArena
+                  std::vector<LifeTarget<N>> &shiftedTargets, // This can be shared
 
                   std::array<unsigned, MAX_CATALYSTS> missingTime,
                   std::array<unsigned, MAX_CATALYSTS> recoveredTime) {
     bool success = false;
     bool failure = false;
-    unsigned successtime;
+    unsigned successtime = 0;
     unsigned failuretime;
 
-    for (unsigned g = config.state.gen; g < filterMaxGen; g++) {
-      // Block the locations that are hit too early
-      if (config.state.gen < params.startGen) {
-        for (unsigned s = 0; s < catalysts.size(); s++) {
-          LifeState hitLocations = config.state.Convolve(catalysts[s].reactionMask);
-          masks[s] |= hitLocations;
-        }
-        config.state.Step();
-        continue;
-      }
+    SearchStats &localStats = LocalStats();
+    localStats.Add(SearchStats::NODES, config.count);
+    unsigned startGen = config.state.gen;
 
+    // Only used once all the catalysts are placed, when there is no
+    // deeper node to share it with
+    CycleWatch<N> &cycleWatch = LocalCycleWatch();
+    cycleWatch.Reset();
+    // The generation simulated up to, if FastForward took over from there
+    unsigned fastForwardGen = 0;
+
+    for (unsigned g = config.state.gen; g < filterMaxGen; g++) {
       if (config.count == 0 && g > params.lastGen)
         failure = true;
       if (config.count < params.numCatalysts && g > params.maxGen)
@@ -1600,8 +3643,22 @@ public:
         break;
       }
 
+      // HasForbidden looks at every generation up to 4 after success, so
+      // a match now rejects every solution found from here (once all the
+      // catalysts are placed, see Configuration::forbiddenCatalyst)
+      if (config.count > 0 && config.forbiddenCatalyst == -1 &&
+          (!success || g <= successtime + 4) && MatchForbidden(config)) {
+        if (config.count == params.numCatalysts) {
+          localStats.Add(SearchStats::FORBIDDEN, config.count);
+          localStats.Add(SearchStats::GENERATIONS, config.count, g - startGen);
+          return;
+        }
+      }
+
       if (config.count == 0) {
         std::cout << "Collision at gen " << g << std::endl;
+        if (checkpoint != nullptr)
+          checkpoint->SetGen(g);
       }
 
       // Try adding a catalyst
@@ -1626,6 +3683,7 @@ public:
         }
 
         if (missingTime[i] > catalysts[config.curs[i]].maxDisappear) {
+          localStats.Add(SearchStats::DISAPPEARED, config.count);
           failuretime = config.state.gen;
           failure = true;
           break;
@@ -1647,41 +3705,137 @@ public:
         }
       }
 
+      // Watch for the board cycling while every catalyst is in place;
+      // it hardly ever does while one is missing
+      if (config.count == params.numCatalysts && !failure) {
+        bool allPresent = true;
+        for (unsigned i = 0; i < config.count; i++)
+          if (missingTime[i] > 0)
+            allPresent = false;
+
+        unsigned period = allPresent ? cycleWatch.Push(config.state) : 0;
+        if (!allPresent)
+          cycleWatch.Reset();
+        if (period != 0) {
+          fastForwardGen = config.state.gen;
+          failuretime = FastForward(config, shiftedTargets, cycleWatch, period, missingTime,
+                                    recoveredTime, success, successtime);
+          failure = true;
+          break;
+        }
+      }
+
       if (config.count == 0)
         Report();
     }
 
     if (!failure)
       failuretime = filterMaxGen;
+    localStats.Add(SearchStats::GENERATIONS, config.count,
+                   (fastForwardGen != 0 ? fastForwardGen : failuretime) - startGen);
 
     if (success)
       ReportSolution(config, successtime, failuretime);
   }
 };
 
-int main(int argc, char *argv[]) {
-  if (argc < 2) {
-    std::cout << "Usage CatForce.exe <in file>" << std::endl;
-    exit(0);
+template <int N>
+void Run(const char *inputFile, unsigned numThreads, unsigned shardIndex,
+         unsigned shardCount, unsigned mergeCount, bool resume) {
+  if (mergeCount != 0) {
+    CatalystSearcher<N> merger;
+    merger.ReadInput(inputFile);
+    merger.Merge(mergeCount);
+    return;
   }
 
-  std::cout << "Input: " << argv[1] << std::endl
+  std::cout << "Input: " << inputFile << std::endl
             << "Initializing please wait..." << std::endl;
 
-  CatalystSearcher searcher;
-  searcher.Init(argv[1]);
-
-  clock_t initialized = clock();
-  printf("Total elapsed time: %f seconds\n",
-         (double) (initialized - searcher.begin) / CLOCKS_PER_SEC);
+  CatalystSearcher<N> searcher;
+  searcher.shardIndex = shardIndex;
+  searcher.shardCount = shardCount;
+  searcher.resume = resume;
+  searcher.Init(inputFile, numThreads);
+  if (shardCount > 1)
+    printf("Searching shard %u of %u\n", shardIndex, shardCount);
+  if (N != 64)
+    printf("Searching a %dx%d torus\n", N, N);
+
+  printf("Total elapsed time: %f seconds\n", searcher.ElapsedSeconds());
+  if (searcher.pool != nullptr)
+    printf("Searching with %u threads\n", searcher.pool->Size());
   std::cout << std::endl
             << "Initialization finished, searching..." << std::endl
             << std::endl;
 
+  std::signal(SIGUSR1, RequestSave);
   searcher.Search();
 
   printf("\n\nFINISH\n");
-  clock_t end = clock();
-  printf("Total elapsed time: %f seconds\n",
-         (double)(end - searcher.begin) / CLOCKS_PER_SEC);
+  printf("Total elapsed time: %f seconds\n", searcher.ElapsedSeconds());
+  searcher.PrintStats(true);
+
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+    long peak = usage.ru_maxrss / 1024; // Bytes on macOS
+#else
+    long peak = usage.ru_maxrss;
+#endif
+    printf("Peak memory: %ld kB\n", peak);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const char *inputFile = nullptr;
+  unsigned numThreads = 0;
+  unsigned shardIndex = 0;
+  unsigned shardCount = 1;
+  unsigned mergeCount = 0;
+  bool resume = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc) {
+      numThreads = std::max(1, atoi(argv[++i]));
+    } else if (arg.compare(0, 2, "-j") == 0 && arg.size() > 2) {
+      numThreads = std::max(1, atoi(arg.c_str() + 2));
+    } else if (arg == "--shard" && i + 1 < argc) {
+      if (sscanf(argv[++i], "%u/%u", &shardIndex, &shardCount) != 2 ||
+          shardCount == 0 || shardIndex >= shardCount) {
+        std::cout << "Bad shard " << argv[i] << ", expected i/n with 0 <= i < n" << std::endl;
+        exit(1);
+      }
+    } else if (arg == "--resume") {
+      resume = true;
+    } else if (arg == "--merge" && i + 1 < argc) {
+      mergeCount = std::max(1, atoi(argv[++i]));
+    } else {
+      inputFile = argv[i];
+    }
+  }
+
+  if (inputFile == nullptr) {
+    std::cout << "Usage CatForce.exe [-j threads] [--shard i/n] [--resume] <in file>" << std::endl
+              << "      CatForce.exe --merge n <in file>" << std::endl;
+    exit(0);
+  }
+
+  // The board size picks the instantiation of the whole search
+  SearchParams params;
+  std::vector<CatalystInput> inputcats;
+  ReadParams(inputFile, inputcats, params);
+
+  switch (params.boardSize) {
+  case 32:
+    Run<32>(inputFile, numThreads, shardIndex, shardCount, mergeCount, resume);
+    break;
+  case 128:
+    Run<128>(inputFile, numThreads, shardIndex, shardCount, mergeCount, resume);
+    break;
+  default:
+    Run<64>(inputFile, numThreads, shardIndex, shardCount, mergeCount, resume);
+    break;
+  }
 }
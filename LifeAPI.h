@@ -12,14 +12,13 @@
 #include <vector>
 #include <iostream>
 #include <sstream>
+#include <string>
 #include <random>
 
 #ifdef __AVX2__
 #include <immintrin.h>
 #endif
 
-#define N 64
-
 #define SUCCESS 1
 #define FAIL 0
 
@@ -63,19 +62,6 @@ inline int __builtin_ctzll(uint64_t x) {
 }
 #endif
 
-inline uint64_t convolve_uint64_t(uint64_t x, uint64_t y) {
-  if(y == 0)
-    return 0;
-
-  uint64_t result = 0;
-  while (x != 0) {
-    int lsb = __builtin_ctzll(x);
-    result |= __builtin_rotateleft64(y, lsb);
-    x &= ~(((uint64_t)1) << lsb);
-  }
-  return result;
-}
-
 namespace PRNG {
   std::random_device rd;
   std::mt19937_64 e2(rd());
@@ -157,6 +143,19 @@ enum StaticSymmetry {
   D8even,
 };
 
+// Columns of the 128x128 torus
+__extension__ typedef unsigned __int128 uint128_t;
+
+// Bit operations on a single column, for every column width
+
+inline uint32_t RotateLeft(uint32_t x, unsigned int k) {
+  return (x << (k & 31)) | (x >> (-k & 31));
+}
+
+inline uint32_t RotateRight(uint32_t x, unsigned int k) {
+  return (x >> (k & 31)) | (x << (-k & 31));
+}
+
 inline uint64_t RotateLeft(uint64_t x, unsigned int k) {
   return __builtin_rotateleft64(x, k);
 }
@@ -165,96 +164,373 @@ inline uint64_t RotateRight(uint64_t x, unsigned int k) {
   return __builtin_rotateright64(x, k);
 }
 
+inline uint128_t RotateLeft(uint128_t x, unsigned int k) {
+  k &= 127;
+  return k == 0 ? x : (x << k) | (x >> (128 - k));
+}
+
+inline uint128_t RotateRight(uint128_t x, unsigned int k) {
+  k &= 127;
+  return k == 0 ? x : (x >> k) | (x << (128 - k));
+}
+
+inline uint32_t RotateLeft(uint32_t x) { return RotateLeft(x, 1); }
+inline uint32_t RotateRight(uint32_t x) { return RotateRight(x, 1); }
 inline uint64_t RotateLeft(uint64_t x) { return RotateLeft(x, 1); }
 inline uint64_t RotateRight(uint64_t x) { return RotateRight(x, 1); }
+inline uint128_t RotateLeft(uint128_t x) { return RotateLeft(x, 1); }
+inline uint128_t RotateRight(uint128_t x) { return RotateRight(x, 1); }
+
+inline int PopCount(uint32_t x) { return __builtin_popcount(x); }
+inline int PopCount(uint64_t x) { return __builtin_popcountll(x); }
+inline int PopCount(uint128_t x) {
+  return __builtin_popcountll((uint64_t)x) + __builtin_popcountll((uint64_t)(x >> 64));
+}
 
-class LifeTarget;
+// Undefined for 0, like the builtins
+inline int CountTrailingZeros(uint32_t x) { return __builtin_ctz(x); }
+inline int CountTrailingZeros(uint64_t x) { return __builtin_ctzll(x); }
+inline int CountTrailingZeros(uint128_t x) {
+  uint64_t low = x;
+  return low != 0 ? __builtin_ctzll(low) : 64 + __builtin_ctzll((uint64_t)(x >> 64));
+}
+
+inline int CountLeadingZeros(uint32_t x) { return __builtin_clz(x); }
+inline int CountLeadingZeros(uint64_t x) { return __builtin_clzll(x); }
+inline int CountLeadingZeros(uint128_t x) {
+  uint64_t high = x >> 64;
+  return high != 0 ? __builtin_clzll(high) : 64 + __builtin_clzll((uint64_t)x);
+}
+
+inline uint32_t BitReverse(uint32_t x) { return __builtin_bitreverse64(x) >> 32; }
+inline uint64_t BitReverse(uint64_t x) { return __builtin_bitreverse64(x); }
+inline uint128_t BitReverse(uint128_t x) {
+  return ((uint128_t)__builtin_bitreverse64((uint64_t)x) << 64) |
+         __builtin_bitreverse64((uint64_t)(x >> 64));
+}
+
+// What a column contributes to LifeState::GetHash
+inline uint64_t HashColumn(uint32_t x) { return x; }
+inline uint64_t HashColumn(uint64_t x) { return x; }
+inline uint64_t HashColumn(uint128_t x) { return (uint64_t)x ^ (uint64_t)(x >> 64); }
 
-class LifeState {
+template <typename W> inline W convolve_column(W x, W y) {
+  if(y == 0)
+    return 0;
+
+  W result = 0;
+  while (x != 0) {
+    int lsb = CountTrailingZeros(x);
+    result |= RotateLeft(y, lsb);
+    x &= ~(((W)1) << lsb);
+  }
+  return result;
+}
+
+// Writes RLE into a caller's buffer from whole rows of cells, finding
+// the runs with bit scans. Dead cells at the end of a row and blank rows
+// are held back until something live follows, so the output is the same
+// as scanning cell by cell.
+class RLEWriter {
 public:
-  uint64_t state[N];
+  explicit RLEWriter(std::string &out) : out(out) {}
+
+  // The lowest length bits of cells, lowest first
+  template <typename W> void Cells(W cells, unsigned length) {
+    if (length < sizeof(W) * 8)
+      cells &= ((W)1 << length) - 1;
+
+    while (cells != 0) {
+      unsigned dead = CountTrailingZeros(cells);
+      Run(false, dead);
+      cells >>= dead;
+      length -= dead;
+
+      W ones = ~cells;
+      unsigned live = ones == 0 ? length : std::min<unsigned>(CountTrailingZeros(ones), length);
+      Run(true, live);
+      length -= live;
+      cells = live == sizeof(W) * 8 ? 0 : cells >> live;
+    }
+    Run(false, length);
+  }
 
+  void Dead(unsigned length) { Run(false, length); }
+
+  void EndRow() {
+    if (runLive)
+      Flush('o');
+    runLive = false;
+    runLength = 0;
+    eolCount++;
+  }
+
+  void Finish() {
+    if (eolCount > 0) {
+      Count(eolCount);
+      out += '$';
+      eolCount = 0;
+    }
+  }
+
+private:
+  std::string &out;
+  unsigned eolCount{};
+  bool runLive{};
+  unsigned runLength{};
+
+  void Run(bool live, unsigned length) {
+    if (length == 0)
+      return;
+    if (live != runLive) {
+      if (live && eolCount > 0)
+        Finish();
+      Flush(runLive ? 'o' : 'b');
+      runLive = live;
+    }
+    runLength += length;
+  }
+
+  void Flush(char tag) {
+    if (runLength > 0) {
+      Count(runLength);
+      out += tag;
+    }
+    runLength = 0;
+  }
+
+  void Count(unsigned count) {
+    if (count <= 1)
+      return;
+    char digits[10];
+    int n = 0;
+    for (; count > 0; count /= 10)
+      digits[n++] = '0' + count % 10;
+    while (n > 0)
+      out += digits[--n];
+  }
+};
+
+// The same column of several boards, one per SIMD lane
+#if defined(__AVX512F__)
+#define LIFE_VECTOR_BYTES 64
+#elif defined(__AVX2__)
+#define LIFE_VECTOR_BYTES 32
+#else
+#define LIFE_VECTOR_BYTES 8
+#endif
+
+typedef uint32_t LifeColumns32 __attribute__((vector_size(LIFE_VECTOR_BYTES)));
+typedef uint64_t LifeColumns64 __attribute__((vector_size(LIFE_VECTOR_BYTES)));
+
+inline LifeColumns32 RotateLeft(LifeColumns32 x) { return (x << 1) | (x >> 31); }
+inline LifeColumns32 RotateRight(LifeColumns32 x) { return (x >> 1) | (x << 31); }
+inline LifeColumns64 RotateLeft(LifeColumns64 x) { return (x << 1) | (x >> 63); }
+inline LifeColumns64 RotateRight(LifeColumns64 x) { return (x >> 1) | (x << 63); }
+
+inline uint32_t GetLane(const LifeColumns32 &x, int lane) { return x[lane]; }
+inline uint64_t GetLane(const LifeColumns64 &x, int lane) { return x[lane]; }
+inline uint128_t GetLane(const uint128_t &x, int) { return x; }
+
+inline void SetLane(LifeColumns32 &x, int lane, uint32_t value) { x[lane] = value; }
+inline void SetLane(LifeColumns64 &x, int lane, uint64_t value) { x[lane] = value; }
+inline void SetLane(uint128_t &x, int, uint128_t value) { x = value; }
+
+// The N by N torus stores a column of N cells in a Word. Columns holds
+// the same column of Lanes boards; there is no vector of 128-bit words,
+// so the 128x128 torus has a single lane.
+template <int N> struct LifeWord;
+
+template <> struct LifeWord<32> {
+  typedef uint32_t Word;
+  typedef LifeColumns32 Columns;
+};
+
+template <> struct LifeWord<64> {
+  typedef uint64_t Word;
+  typedef LifeColumns64 Columns;
+};
+
+template <> struct LifeWord<128> {
+  typedef uint128_t Word;
+  typedef uint128_t Columns;
+};
+
+template <int N> class LifeTarget;
+template <int N> class LifeKernel;
+template <int N> class LifeMatcher;
+template <int N> class LifeStateBatch;
+
+template <int N> class LifeState {
+  friend class LifeStateBatch<N>;
+
+public:
+  typedef typename LifeWord<N>::Word Word;
+
+  Word state[N];
+
+  // Every live cell is in columns min..max, wrapping around the torus
+  // when min > max. Operations keep min and max on live columns where
+  // that is cheap, so the bounds are usually exact. An empty state has
+  // min == max on an empty column.
   int min;
   int max;
   int gen;
 
-  LifeState() : state{0}, min(0), max(N - 1), gen(0) {}
+  LifeState() : state{0}, min(0), max(0), gen(0) {}
+
+  int BoundsWidth() const {
+    if (min == max && state[min] == 0)
+      return 0;
+    return (max - min + N) % N + 1;
+  }
+
+  void SetBounds(int start, int width) {
+    if (width <= 0) {
+      min = 0;
+      max = 0;
+    } else if (width >= N) {
+      min = 0;
+      max = N - 1;
+    } else {
+      min = (start % N + N) % N;
+      max = (min + width - 1) % N;
+    }
+  }
+
+  // Calls f(i) for each column i within the bounds
+  template <typename F> void ForEachColumn(F f) const {
+    if (min <= max) {
+      for (int i = min; i <= max; i++)
+        f(i);
+    } else {
+      for (int i = min; i < N; i++)
+        f(i);
+      for (int i = 0; i <= max; i++)
+        f(i);
+    }
+  }
+
+  // Start and width of bounds covering two sets of bounds, given as
+  // start and width
+  static std::pair<int, int> UnionBounds(int aMin, int aWidth, int bMin, int bWidth) {
+    if (aWidth == 0)
+      return std::make_pair(bMin, bWidth);
+    if (bWidth == 0)
+      return std::make_pair(aMin, aWidth);
 
-  void Set(int x, int y) { state[x] |= (1ULL << (y)); }
-  void Erase(int x, int y) { state[x] &= ~(1ULL << (y)); }
-  int Get(int x, int y) const { return (state[x] & (1ULL << y)) >> y; }
+    int fromA = std::max(aWidth, CoverWidth(aMin, bMin, bWidth));
+    int fromB = std::max(bWidth, CoverWidth(bMin, aMin, aWidth));
+    if (fromA <= fromB)
+      return std::make_pair(aMin, fromA);
+    else
+      return std::make_pair(bMin, fromB);
+  }
+
+private:
+  // Width of the bounds starting at start that also cover the given
+  // bounds
+  static int CoverWidth(int start, int otherMin, int otherWidth) {
+    return std::min(N, ((otherMin - start) % N + N) % N + otherWidth);
+  }
+
+  void SetUnionBounds(int aMin, int aWidth, int bMin, int bWidth) {
+    std::pair<int, int> bounds = UnionBounds(aMin, aWidth, bMin, bWidth);
+    SetBounds(bounds.first, bounds.second);
+  }
+
+  // Move min and max inwards past empty columns
+  void TightenBounds() {
+    int width = BoundsWidth();
+    int first = 0;
+    while (first < width && state[(min + first) % N] == 0)
+      first++;
+    if (first == width) {
+      SetBounds(0, 0);
+      return;
+    }
+
+    int last = width - 1;
+    while (state[(min + last) % N] == 0)
+      last--;
+
+    max = (min + last) % N;
+    min = (min + first) % N;
+  }
+
+public:
+  void Set(int x, int y) {
+    state[x] |= ((Word)1 << (y));
+    int width = BoundsWidth();
+    if (width == 0 || (x - min + N) % N >= width)
+      SetUnionBounds(min, width, x, 1);
+  }
+  void Erase(int x, int y) { state[x] &= ~((Word)1 << (y)); }
+  int Get(int x, int y) const { return (state[x] & ((Word)1 << y)) >> y; }
   void SetCell(int x, int y, int val) {
     if (val == 1) {
-      Set((x + 64) % N, (y + 64) % 64);
+      Set((x % N + N) % N, (y % N + N) % N);
     }
     if (val == 0)
-      Erase((x + 64) % N, (y + 64) % 64);
+      Erase((x % N + N) % N, (y % N + N) % N);
   }
   int GetCell(int x, int y) const {
-    return Get((x + 64) % N, (y + 64) % 64);
+    return Get((x % N + N) % N, (y % N + N) % N);
   }
   uint64_t GetHash() const {
     uint64_t result = 0;
 
-    for (int i = 0; i < N; i++) {
-      result += RotateLeft(state[i], (int)(i / 2));
-    }
+    ForEachColumn([&](int i) { result += HashColumn(RotateLeft(state[i], (int)(i / 2))); });
 
     return result;
   }
 
-#ifdef __AVX2__
+  // Bit i is set when column i has a live cell. The torus is square, so
+  // this fits in a column.
+  Word ColumnMask() const {
+    Word mask = 0;
+    for (int i = 0; i < N; i++)
+      mask |= (Word)(state[i] != 0) << i;
+    return mask;
+  }
+
+  // The tightest bounds: everything but the longest run of empty columns
   void RecalculateMinMax() {
-    min = 0;
-    max = N - 1;
+    Word columns = ColumnMask();
+    if (columns == 0) {
+      SetBounds(0, 0);
+      return;
+    }
+    if (columns == ~(Word)0) {
+      SetBounds(0, N);
+      return;
+    }
 
-    const char *p = (const char *)state;
-    size_t len = 8*N;
-    const char *p_init = p;
-    const char *endp = p + len;
-    do {
-      __m256i v1 = _mm256_loadu_si256((const __m256i*)p);
-      __m256i v2 = _mm256_loadu_si256((const __m256i*)(p+32));
-      __m256i vor = _mm256_or_si256(v1,v2);
-      if (!_mm256_testz_si256(vor, vor)) {
-        min = (p-p_init)/8;
-        break;
-      }
-      p += 64;
-    } while(p < endp);
+    // Rotate a live column to bit 0 so that no run of empty columns wraps
+    int offset = CountTrailingZeros(columns);
+    Word rotated = RotateRight(columns, offset);
 
-    p = endp-64;
-    do {
-      __m256i v1 = _mm256_loadu_si256((const __m256i*)p);
-      __m256i v2 = _mm256_loadu_si256((const __m256i*)(p+32));
-      __m256i vor = _mm256_or_si256(v1,v2);
-      if (!_mm256_testz_si256(vor, vor)) {
-        max = (p-p_init)/8 + 7;
+    int bestStart = 0;
+    int bestLength = 0;
+    int pos = 0;
+    while (true) {
+      pos += CountTrailingZeros((Word)~(rotated >> pos));
+      if (pos >= N)
         break;
-      }
-      p -= 64;
-    } while(p >= p_init);
-  }
-#else
-  void RecalculateMinMax() {
-    min = 0;
-    max = N - 1;
 
-    for (int i = 0; i < N; i++) {
-      if (state[i] != 0) {
-        min = i;
-        break;
+      Word rest = rotated >> pos;
+      int length = rest == 0 ? N - pos : CountTrailingZeros(rest);
+      if (length > bestLength) {
+        bestStart = pos;
+        bestLength = length;
       }
-    }
-
-    for (int i = N - 1; i >= 0; i--) {
-      if (state[i] != 0) {
-        max = i;
+      pos += length;
+      if (pos >= N)
         break;
-      }
     }
+
+    SetBounds(offset + bestStart + bestLength, N - bestLength);
   }
-#endif
 
 public:
   void Print() const;
@@ -270,19 +546,16 @@ public:
       return;
     }
     if (op == OR) {
-      for (int i = 0; i < N; i++)
-        state[i] |= delta.state[i];
-      min = std::min(min, delta.min);
-      max = std::max(max, delta.max);
+      *this |= delta;
       return;
     }
     if (op == AND) {
-      for (int i = 0; i < N; i++)
-        state[i] &= delta.state[i];
+      *this &= delta;
     }
     if (op == ANDNOT) {
       for (int i = 0; i < N; i++)
         state[i] &= ~delta.state[i];
+      TightenBounds();
     }
     if (op == ORNOT) {
       for (int i = 0; i < N; i++)
@@ -290,54 +563,92 @@ public:
       RecalculateMinMax();
     }
     if (op == XOR) {
-      for (int i = 0; i < N; i++)
-        state[i] ^= delta.state[i];
-      RecalculateMinMax();
+      *this ^= delta;
     }
   }
 
   void Copy(const LifeState &delta) { Copy(delta, COPY); }
 
   inline void Copy(const LifeState &delta, int x, int y) {
-    uint64_t temp1[N] = {0};
+    Word temp1[N] = {0};
+    int deltaMin = delta.min;
+    int deltaWidth = delta.BoundsWidth();
 
     if (x < 0)
       x += N;
     if (y < 0)
-      y += 64;
+      y += N;
 
-    for (int i = delta.min; i <= delta.max; i++)
+    for (int i = 0; i < N; i++)
       temp1[i] = RotateLeft(delta.state[i], y);
 
-    memmove(state, temp1 + (N - x), x * sizeof(uint64_t));
-    memmove(state + x, temp1, (N - x) * sizeof(uint64_t));
+    memmove(state, temp1 + (N - x), x * sizeof(Word));
+    memmove(state + x, temp1, (N - x) * sizeof(Word));
 
-    min = 0;
-    max = N - 1;
+    SetBounds(deltaMin + x, deltaWidth);
   }
 
   void Join(const LifeState &delta) { Copy(delta, OR); }
 
   void Join(const LifeState &delta, int x, int y) {
-    uint64_t temp[2*N] = {0};
+    Word temp[2*N] = {0};
 
     if (x < 0)
       x += N;
     if (y < 0)
-      y += 64;
+      y += N;
 
     for (int i = 0; i < N; i++) {
       temp[i]   = RotateLeft(delta.state[i], y);
       temp[i+N] = RotateLeft(delta.state[i], y);
     }
 
+    int width = BoundsWidth();
+
     const int shift = N - x;
     for (int i = 0; i < N; i++) {
       state[i] |= temp[i+shift];
     }
 
-    min = 0;
-    max = N - 1;
+    SetUnionBounds(min, width, delta.min + x, delta.BoundsWidth());
+  }
+
+  // Equivalent to *this = base; Join(delta, x, y); but in a single pass
+  void JoinMoved(const LifeState &base, const LifeState &delta, int x, int y) {
+    if (x < 0)
+      x += N;
+    if (y < 0)
+      y += N;
+
+    int baseMin = base.min;
+    int baseWidth = base.BoundsWidth();
+
+    for (int i = 0; i < N; i++)
+      state[i] = base.state[i] | RotateLeft(delta.state[(i + N - x) % N], y);
+
+    SetUnionBounds(baseMin, baseWidth, delta.min + x, delta.BoundsWidth());
+    gen = base.gen;
+  }
+
+  // The same, with delta given by its columns deltaMin onwards and
+  // empty elsewhere
+  void JoinMoved(const LifeState &base, const Word *columns, int deltaMin,
+                 int deltaWidth, int x, int y) {
+    if (x < 0)
+      x += N;
+    if (y < 0)
+      y += N;
+
+    int baseMin = base.min;
+    int baseWidth = base.BoundsWidth();
+
+    if (this != &base)
+      memcpy(state, base.state, sizeof(state));
+    for (int k = 0; k < deltaWidth; k++)
+      state[(deltaMin + x + k) % N] |= RotateLeft(columns[k], y);
+
+    SetUnionBounds(baseMin, baseWidth, deltaMin + x, deltaWidth);
+    gen = base.gen;
   }
 
   void JoinWSymChain(const LifeState &state, int x, int y,
@@ -374,9 +685,7 @@ public:
   unsigned GetPop() const {
     unsigned pop = 0;
 
-    for (int i = 0; i < N; i++) {
-      pop += __builtin_popcountll(state[i]);
-    }
+    ForEachColumn([&](int i) { pop += PopCount(state[i]); });
 
     return pop;
   }
@@ -391,10 +700,8 @@ public:
   // }
 
   bool IsEmpty() const {
-    uint64_t all = 0;
-    for (int i = 0; i < N; i++) {
-      all |= state[i];
-    }
+    Word all = 0;
+    ForEachColumn([&](int i) { all |= state[i]; });
 
     return all == 0;
   }
@@ -403,6 +710,8 @@ public:
     for (int i = 0; i < N; i++) {
       state[i] = ~state[i];
     }
+    SetBounds(0, N);
+    TightenBounds();
   }
 
   bool operator==(const LifeState &b) const {
@@ -422,89 +731,82 @@ public:
     for (int i = 0; i < N; i++) {
       result.state[i] = ~state[i];
     }
+    result.SetBounds(0, N);
     return result;
   }
 
   LifeState operator&(const LifeState &other) const {
-    LifeState result;
-    for (int i = 0; i < N; i++) {
-      result.state[i] = state[i] & other.state[i];
-    }
+    LifeState result = *this;
+    result &= other;
     return result;
   }
 
   LifeState& operator&=(const LifeState &other) {
+    // Either operand's bounds will do, so start from the narrower
+    if (other.BoundsWidth() < BoundsWidth()) {
+      min = other.min;
+      max = other.max;
+    }
     for (int i = 0; i < N; i++) {
       state[i] = state[i] & other.state[i];
     }
+    TightenBounds();
     return *this;
   }
 
   LifeState operator|(const LifeState &other) const {
-    LifeState result;
-    for (int i = 0; i < N; i++) {
-      result.state[i] = state[i] | other.state[i];
-    }
+    LifeState result = *this;
+    result |= other;
     return result;
   }
 
   LifeState& operator|=(const LifeState &other) {
+    int width = BoundsWidth();
     for (int i = 0; i < N; i++) {
       state[i] = state[i] | other.state[i];
     }
+    SetUnionBounds(min, width, other.min, other.BoundsWidth());
     return *this;
   }
 
   LifeState operator^(const LifeState &other) const {
-    LifeState result;
-    for (int i = 0; i < N; i++) {
-      result.state[i] = state[i] ^ other.state[i];
-    }
+    LifeState result = *this;
+    result ^= other;
     return result;
   }
 
   LifeState& operator^=(const LifeState &other) {
+    int width = BoundsWidth();
     for (int i = 0; i < N; i++) {
       state[i] = state[i] ^ other.state[i];
     }
+    SetUnionBounds(min, width, other.min, other.BoundsWidth());
+    TightenBounds();
     return *this;
   }
 
   inline bool AreDisjoint(const LifeState &pat) const {
-    int min = 0;
-    int max = N - 1;
+    const LifeState &narrower = pat.BoundsWidth() < BoundsWidth() ? pat : *this;
 
-    uint64_t differences = 0;
-    #pragma clang loop vectorize(enable)
-    for (int i = min; i <= max; i++) {
-      uint64_t difference = state[i] & pat.state[i];
-      differences |= difference;
-    }
+    Word differences = 0;
+    narrower.ForEachColumn([&](int i) { differences |= state[i] & pat.state[i]; });
 
     return differences == 0;
   }
 
   inline bool Contains(const LifeState &pat) const {
-    int min = 0;
-    int max = N - 1;
-
-    uint64_t differences = 0;
-    #pragma clang loop vectorize(enable)
-    for (int i = min; i <= max; i++) {
-      uint64_t difference = ~state[i] & pat.state[i];
-      differences |= difference;
-    }
+    Word differences = 0;
+    pat.ForEachColumn([&](int i) { differences |= ~state[i] & pat.state[i]; });
 
     return differences == 0;
   }
 
   bool Contains(const LifeState &pat, int targetDx, int targetDy) const {
-    int min = pat.min;
-    int max = pat.max;
-
-    int dy = (targetDy + 64) % 64;
+    int width = pat.BoundsWidth();
+    int dy = (targetDy % N + N) % N;
 
-    for (int i = min; i <= max; i++) {
+    for (int k = 0; k < width; k++) {
+      int i = (pat.min + k) % N;
       int curX = (N + i + targetDx) % N;
 
       if ((RotateRight(state[curX], dy) & pat.state[i]) != (pat.state[i]))
@@ -514,11 +816,11 @@ public:
   }
 
   bool AreDisjoint(const LifeState &pat, int targetDx, int targetDy) const {
-    int min = pat.min;
-    int max = pat.max;
-    int dy = (targetDy + 64) % 64;
+    int width = pat.BoundsWidth();
+    int dy = (targetDy % N + N) % N;
 
-    for (int i = min; i <= max; i++) {
+    for (int k = 0; k < width; k++) {
+      int i = (pat.min + k) % N;
       int curX = (N + i + targetDx) % N;
 
       if (((~RotateRight(state[curX], dy)) & pat.state[i]) != pat.state[i])
@@ -528,27 +830,30 @@ public:
     return true;
   }
 
-  inline bool Contains(const LifeTarget &target, int dx, int dy) const;
-  inline bool Contains(const LifeTarget &target) const;
+  inline bool Contains(const LifeTarget<N> &target, int dx, int dy) const;
+  inline bool Contains(const LifeTarget<N> &target) const;
 
   void Reverse(int idxS, int idxE) {
     for (int i = 0; idxS + 2*i < idxE; i++) {
       int l = idxS + i;
       int r = idxE - i;
 
-      uint64_t temp = state[l];
+      Word temp = state[l];
       state[l] = state[r];
       state[r] = temp;
     }
+    RecalculateMinMax();
   }
 
   void Move(int x, int y) {
-    uint64_t temp[2*N] = {0};
+    Word temp[2*N] = {0};
 
     if (x < 0)
       x += N;
     if (y < 0)
-      y += 64;
+      y += N;
+
+    int width = BoundsWidth();
 
     for (int i = 0; i < N; i++) {
       temp[i]   = RotateLeft(state[i], y);
@@ -560,31 +865,29 @@ public:
       state[i] = temp[i+shift];
     }
 
-    if ((min + x) % N < (max + x) % N) {
-      min = (min + x) % N;
-      max = (max + x) % N;
-    } else {
-      min = 0;
-      max = N - 1;
-    }
+    SetBounds(min + x, width);
   }
 
   void BitReverse() {
     for (int i = 0; i < N; i++) {
-      state[i] = __builtin_bitreverse64(state[i]);
+      state[i] = ::BitReverse(state[i]);
     }
   }
 
   void FlipY() { // even reflection across y-axis, ie (0,0) maps to (0, -1)
-    Reverse(0, N - 1);
+    int width = BoundsWidth();
+    int newMin = N - 1 - max;
+    for (int i = 0; 2 * i < N - 1; i++)
+      std::swap(state[i], state[N - 1 - i]);
+    SetBounds(newMin, width);
   }
 
   void Transpose(bool whichDiagonal) {
     int j, k;
-    uint64_t m, t;
+    Word m, t;
 
-    for (j = 32, m = 0x00000000FFFFFFFF; j; j >>= 1, m ^= m << j) {
-      for (k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+    for (j = N / 2, m = ~(Word)0 >> (N / 2); j; j >>= 1, m ^= m << j) {
+      for (k = 0; k < N; k = ((k | j) + 1) & ~j) {
         if (whichDiagonal) {
           t = (state[k] ^ (state[k | j] >> j)) & m;
           state[k] ^= t;
@@ -596,8 +899,7 @@ public:
         }
       }
     }
-    min = 0;
-    max = N - 1;
+    RecalculateMinMax();
   }
 
   void Transpose() { Transpose(true); }
@@ -616,7 +918,7 @@ public:
     LifeState temp;
     LifeState boundary;
     for (int i = 0; i < N; i++) {
-      uint64_t col = state[i];
+      Word col = state[i];
       temp.state[i] = col | RotateLeft(col) | RotateRight(col);
     }
 
@@ -627,7 +929,8 @@ public:
 
     boundary.state[N - 1] = temp.state[N - 2] | temp.state[N - 1] | temp.state[0];
 
-    boundary.RecalculateMinMax();
+    int width = BoundsWidth();
+    boundary.SetBounds(min - 1, width == 0 ? 0 : width + 2);
     return boundary;
   }
 
@@ -665,93 +968,107 @@ public:
     zoi.state[N - 1] = c.state[N - 1] | RotateLeft(c.state[N - 1]) |
       RotateRight(c.state[N - 1]);
 
-    zoi.RecalculateMinMax();
+    int width = BoundsWidth();
+    zoi.SetBounds(min - 2, width == 0 ? 0 : width + 4);
     return zoi;
   }
 
-  static inline void ConvolveInner(LifeState &result, const uint64_t (&doubledother)[N*2], uint64_t x, unsigned int k, unsigned int postshift) {
-    for (int i = 0; i < N; i++) {
-      result.state[i] |= __builtin_rotateleft64(convolve_uint64_t(x, doubledother[i+k]), postshift);
+  // Only the columns i where doubledother[i+k] lies in the bounds of
+  // other, starting from column start, can receive anything
+  static inline void ConvolveInner(LifeState &result, const Word (&doubledother)[N*2], Word x, unsigned int k, unsigned int postshift, int start, int width) {
+    int end = std::min(start + width, N);
+    for (int i = start; i < end; i++) {
+      result.state[i] |= RotateLeft(convolve_column(x, doubledother[i+k]), postshift);
+    }
+    for (int i = 0; i < start + width - N; i++) {
+      result.state[i] |= RotateLeft(convolve_column(x, doubledother[i+k]), postshift);
     }
   }
 
   LifeState Convolve(const LifeState &other) const {
     LifeState result;
-    uint64_t doubledother[N*2];
-    memcpy(doubledother,     other.state, N * sizeof(uint64_t));
-    memcpy(doubledother + N, other.state, N * sizeof(uint64_t));
+    Word doubledother[N*2];
+    memcpy(doubledother,     other.state, N * sizeof(Word));
+    memcpy(doubledother + N, other.state, N * sizeof(Word));
+
+    int otherWidth = other.BoundsWidth();
+    if (otherWidth == 0)
+      return result;
 
     for (unsigned j = 0; j < N; j++) {
-      unsigned k = 64-j;
-      uint64_t x = state[j];
+      unsigned k = N-j;
+      Word x = state[j];
+      int start = (other.min + j) % N;
 
       // Annoying special case
-      if(x == ~0ULL) {
-        ConvolveInner(result, doubledother, ~0ULL, k, 0);
+      if(x == ~(Word)0) {
+        ConvolveInner(result, doubledother, ~(Word)0, k, 0, start, otherWidth);
         continue;
       }
 
     while (x != 0) {
       unsigned int postshift;
 
-      uint64_t shifted;
+      Word shifted;
 
       if((x & 1) == 0) { // Possibly wrapped
-        int lsb = __builtin_ctzll(x);
-        shifted = __builtin_rotateright64(x, lsb);
+        int lsb = CountTrailingZeros(x);
+        shifted = RotateRight(x, lsb);
         postshift = lsb;
       } else{
-        int lead = __builtin_clzll(~x);
-        shifted = __builtin_rotateleft64(x, lead);
-        postshift = 64-lead;
+        int lead = CountLeadingZeros((Word)~x);
+        shifted = RotateLeft(x, lead);
+        postshift = N-lead;
       }
 
-      unsigned runlength = __builtin_ctzll(~shifted);
+      unsigned runlength = CountTrailingZeros((Word)~shifted);
       runlength = std::min(runlength, (unsigned)32);
-      uint64_t run = (1ULL << runlength) - 1;
+      Word run = ((Word)1 << runlength) - 1;
 
       switch(run) {
-      case (1 << 1) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 2) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 3) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 4) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 5) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 6) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 7) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 8) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 9) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 10) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 11) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 12) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 13) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 14) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 15) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 16) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 17) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 18) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 19) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 20) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 21) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 22) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 23) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 24) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 25) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 26) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 27) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 28) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 29) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1 << 30) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1ULL << 31) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      case (1ULL << 32) - 1: ConvolveInner(result, doubledother, run, k, postshift); break;
-      default:           ConvolveInner(result, doubledother, run, k, postshift); break;
+      case (1 << 1) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 2) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 3) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 4) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 5) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 6) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 7) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 8) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 9) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 10) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 11) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 12) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 13) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 14) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 15) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 16) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 17) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 18) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 19) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 20) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 21) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 22) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 23) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 24) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 25) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 26) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 27) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 28) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 29) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1 << 30) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1ULL << 31) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      case (1ULL << 32) - 1: ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
+      default:           ConvolveInner(result, doubledother, run, k, postshift, start, otherWidth); break;
       }
 
-      x &= ~__builtin_rotateleft64(run, postshift);
+      x &= ~RotateLeft(run, postshift);
     }
     }
 
-    result.min = 0;
-    result.max = N - 1;
+    // The Minkowski sum of the two bounds
+    int width = BoundsWidth();
+    if (width != 0)
+      result.SetBounds(min + other.min, width + otherWidth - 1);
 
     return result;
   }
@@ -785,33 +1102,64 @@ public:
     return MatchLiveAndDead(live, live.GetBoundary());
   }
 
-  LifeState Match(const LifeTarget &target) const;
+  LifeState Match(const LifeTarget<N> &target) const;
+  int MatchFirst(const std::vector<LifeMatcher<N>> &matchers, LifeState &matches) const;
+
+  LifeState Convolve(const LifeKernel<N> &kernel) const;
+  void Convolve(const LifeKernel<N> *const *kernels, unsigned count, LifeState *results) const;
 
 private:
-  void inline Add(uint64_t &b1, uint64_t &b0, const uint64_t &val) {
+  // run becomes columns ORed with its rotations up by 1 to length - 1
+  // rows, for each of width columns
+  static void SpreadRun(const Word *columns, int width, unsigned length, Word *run) {
+    for (int t = 0; t < width; t++)
+      run[t] = columns[t];
+    unsigned covered = 1;
+    while (2 * covered <= length) {
+      for (int t = 0; t < width; t++)
+        run[t] |= RotateLeft(run[t], covered);
+      covered *= 2;
+    }
+    unsigned rest = length - covered;
+    if (rest != 0)
+      for (int t = 0; t < width; t++)
+        run[t] |= RotateLeft(run[t], rest);
+  }
+
+  // ORs the width columns of spread into this from column start,
+  // wrapping around
+  void JoinColumns(const Word *spread, int start, int width) {
+    int first = std::min(width, N - start);
+    for (int t = 0; t < first; t++)
+      state[start + t] |= spread[t];
+    for (int t = first; t < width; t++)
+      state[t - first] |= spread[t];
+  }
+
+  void inline Add(Word &b1, Word &b0, const Word &val) {
     b1 |= b0 & val;
     b0 ^= val;
   }
 
-  void inline Add(uint64_t &b2, uint64_t &b1, uint64_t &b0,
-                  const uint64_t &val) {
-    uint64_t t_b2 = b0 & val;
+  void inline Add(Word &b2, Word &b1, Word &b0,
+                  const Word &val) {
+    Word t_b2 = b0 & val;
 
     b2 |= t_b2 & b1;
     b1 ^= t_b2;
     b0 ^= val;
   }
 
-  uint64_t inline Evolve(const uint64_t &temp, const uint64_t &bU0,
-                         const uint64_t &bU1, const uint64_t &bB0,
-                         const uint64_t &bB1) {
-    uint64_t sum0 = RotateLeft(temp);
+  Word inline Evolve(const Word &temp, const Word &bU0,
+                     const Word &bU1, const Word &bB0,
+                     const Word &bB1) {
+    Word sum0 = RotateLeft(temp);
 
-    uint64_t sum1 = 0;
+    Word sum1 = 0;
     Add(sum1, sum0, RotateRight(temp));
     Add(sum1, sum0, bU0);
 
-    uint64_t sum2 = 0;
+    Word sum2 = 0;
     Add(sum2, sum1, bU1);
     Add(sum2, sum1, sum0, bB0);
     Add(sum2, sum1, bB1);
@@ -821,15 +1169,16 @@ private:
 
   // From Page 15 of
   // https://www.gathering4gardner.org/g4g13gift/math/RokickiTomas-GiftExchange-LifeAlgorithms-G4G13.pdf
-  uint64_t inline Rokicki(const uint64_t &a, const uint64_t &bU0,
-                          const uint64_t &bU1, const uint64_t &bB0,
-                          const uint64_t &bB1) {
-    uint64_t aw = RotateLeft(a);
-    uint64_t ae = RotateRight(a);
-    uint64_t s0 = aw ^ ae;
-    uint64_t s1 = aw & ae;
-    uint64_t ts0 = bB0 ^ bU0;
-    uint64_t ts1 = (bB0 & bU0) | (ts0 & s0);
+  // W is either a single column or a LifeWord<N>::Columns
+  template <typename W>
+  static inline W Rokicki(const W &a, const W &bU0, const W &bU1,
+                          const W &bB0, const W &bB1) {
+    W aw = RotateLeft(a);
+    W ae = RotateRight(a);
+    W s0 = aw ^ ae;
+    W s1 = aw & ae;
+    W ts0 = bB0 ^ bU0;
+    W ts1 = (bB0 & bU0) | (ts0 & s0);
     return (bB1 ^ bU1 ^ ts1 ^ s1) & ((bB1 | bU1) ^ (ts1 | s1)) &
            ((ts0 ^ s0) | a);
   }
@@ -889,11 +1238,17 @@ public:
   static LifeState Parse(const char *rle) { return Parse(rle, 0, 0); }
 
   std::string RLE() const;
+  void RLE(std::string &out) const;
+  // The N rows of the board from y = -N/2 down, each with the cell at
+  // x = -N/2 in its lowest bit
+  void RLERows(Word *rows) const;
 
   static LifeState RandomState() {
     LifeState result;
-    for (int i = 0; i < N; i++)
-      result.state[i] = PRNG::dist(PRNG::e2);
+    for (int i = 0; i < N; i++) {
+      uint64_t words[2] = {PRNG::dist(PRNG::e2), PRNG::dist(PRNG::e2)};
+      memcpy(&result.state[i], words, sizeof(Word));
+    }
 
     result.RecalculateMinMax();
 
@@ -905,7 +1260,7 @@ public:
   std::pair<int, int> FirstOn() const
   {
     const char *p = (const char *)state;
-    size_t len = 8*N;
+    size_t len = sizeof(state);
     //assert(len % 64 == 0);
     //optimal if p is 64-byte aligned, so we're checking single cache-lines
     const char *p_init = p;
@@ -923,11 +1278,9 @@ public:
         unsigned idx = __builtin_ctz(~zero_map);  // Use ctzll for GCC, because GCC is dumb and won't optimize away a movsx
         uint32_t nonzero_chunk;
         memcpy(&nonzero_chunk, p+4*idx, sizeof(nonzero_chunk));  // aliasing / alignment-safe load
-        if(idx % 2 == 0) {
-          return std::make_pair((p-p_init + 4*idx)/8, __builtin_ctz(nonzero_chunk));
-        } else {
-          return std::make_pair((p-p_init + 4*(idx-1))/8, __builtin_ctz(nonzero_chunk) + 32);
-        }
+        size_t offset = p-p_init + 4*idx;
+        return std::make_pair(offset / sizeof(Word),
+                              __builtin_ctz(nonzero_chunk) + 8 * (offset % sizeof(Word)));
       }
       p += 64;
     } while(p < endp);
@@ -935,30 +1288,11 @@ public:
   }
 #else
   std::pair<int, int> FirstOn() const {
-    int foundq = 64;
-    for (int x = 0; x < N; x+=4) {
-      if (state[x] != 0ULL ||
-          state[x+1] != 0ULL ||
-          state[x+2] != 0ULL ||
-          state[x+3] != 0ULL) {
-        foundq = x;
-      }
+    for (int x = 0; x < N; x++) {
+      if (state[x] != 0)
+        return std::make_pair(x, CountTrailingZeros(state[x]));
     }
-    if (foundq == 64) {
-      return std::make_pair(0, 0);
-    }
-
-    int foundx;
-    if (state[foundq] != 0ULL) {
-      foundx = foundq;
-    } else if (state[foundq + 1] != 0ULL) {
-      foundx = foundq + 1;
-    } else if (state[foundq + 2] != 0ULL) {
-      foundx = foundq + 2;
-    } else if (state[foundq + 3] != 0ULL) {
-      foundx = foundq + 3;
-    }
-    return std::make_pair(foundx, __builtin_ctzll(state[foundx]));
+    return std::make_pair(-1, -1);
   }
 #endif
 
@@ -970,11 +1304,11 @@ public:
   }
 
   static LifeState SolidRect(int x, int y, int w, int h) {
-    uint64_t column;
-    if (h < 64)
-      column = RotateLeft(((uint64_t)1 << h) - 1, y);
+    Word column;
+    if (h < N)
+      column = RotateLeft(((Word)1 << h) - 1, y);
     else
-      column = ~0ULL;
+      column = ~(Word)0;
 
     unsigned start, end;
     if (w < N) {
@@ -995,39 +1329,40 @@ public:
       for (unsigned int i = start; i < N; i++)
         result.state[i] = column;
     }
+    result.RecalculateMinMax();
     return result;
   }
 
   std::array<int, 4> XYBounds() const {
-    int minCol = -32;
-    int maxCol = 31;
+    int minCol = -N / 2;
+    int maxCol = N / 2 - 1;
 
-    for (int i = -32; i <= 31; i++) {
-      if (state[(i + 64) % 64] != 0) {
+    for (int i = -N / 2; i <= N / 2 - 1; i++) {
+      if (state[(i + N) % N] != 0) {
         minCol = i;
         break;
       }
     }
 
-    for (int i = 31; i >= -32; i--) {
-      if (state[(i + 64) % 64] != 0) {
+    for (int i = N / 2 - 1; i >= -N / 2; i--) {
+      if (state[(i + N) % N] != 0) {
         maxCol = i;
         break;
       }
     }
 
-    uint64_t orOfCols(0);
+    Word orOfCols(0);
     for (int i = minCol; i <= maxCol; ++i) {
-      orOfCols = orOfCols | state[(i + 64) % 64];
+      orOfCols = orOfCols | state[(i + N) % N];
     }
-    if (orOfCols == 0ULL) {
+    if (orOfCols == 0) {
       return std::array<int, 4>({0, 0, 0, 0});
     }
-    orOfCols = __builtin_rotateright64(orOfCols, 32);
-    int topMargin = __builtin_ctzll(orOfCols);
-    int bottomMargin = __builtin_clzll(orOfCols);
+    orOfCols = RotateRight(orOfCols, N / 2);
+    int topMargin = CountTrailingZeros(orOfCols);
+    int bottomMargin = CountLeadingZeros(orOfCols);
     return std::array<int, 4>(
-        {minCol, topMargin - 32, maxCol, 31 - bottomMargin});
+        {minCol, topMargin - N / 2, maxCol, N / 2 - 1 - bottomMargin});
   }
 
   LifeState ComponentContaining(const LifeState &seed, const LifeState &corona) const {
@@ -1060,55 +1395,188 @@ public:
   }
 };
 
-void LifeState::Step() {
-  uint64_t tempxor[N];
-  uint64_t tempand[N];
+template <int N> void LifeState<N>::Step() {
+  Word tempxor[N];
+  Word tempand[N];
 
-  for (int i = 0; i < N; i++) {
-    uint64_t l = RotateLeft(state[i]);
-    uint64_t r = RotateRight(state[i]);
-    tempxor[i] = l ^ r ^ state[i];
-    tempand[i] = ((l ^ r) & state[i]) | (l & r);
+  int width = BoundsWidth();
+  if (width == 0) {
+    gen++;
+    return;
   }
 
-  #pragma clang loop unroll(full)
-  for (int i = 0; i < N; i++) {
-    int idxU;
-    int idxB;
-    if (i == 0)
-      idxU = N - 1;
-    else
-      idxU = i - 1;
+  if (width + 4 > N) {
+    for (int i = 0; i < N; i++) {
+      Word l = RotateLeft(state[i]);
+      Word r = RotateRight(state[i]);
+      tempxor[i] = l ^ r ^ state[i];
+      tempand[i] = ((l ^ r) & state[i]) | (l & r);
+    }
 
-    if (i == N - 1)
-      idxB = 0;
-    else
-      idxB = i + 1;
+    #pragma clang loop unroll(full)
+    for (int i = 0; i < N; i++) {
+      int idxU;
+      int idxB;
+      if (i == 0)
+        idxU = N - 1;
+      else
+        idxU = i - 1;
+
+      if (i == N - 1)
+        idxB = 0;
+      else
+        idxB = i + 1;
+
+      state[i] = Rokicki(state[i], tempxor[idxU], tempand[idxU], tempxor[idxB], tempand[idxB]);
+    }
 
-    state[i] = Rokicki(state[i], tempxor[idxU], tempand[idxU], tempxor[idxB], tempand[idxB]);
+    RecalculateMinMax();
+    gen++;
+    return;
   }
 
-  // int s = min + 1;
-  // int e = max - 1;
+  // Only columns min - 1 to max + 1 can change. Work on min - 2 to
+  // max + 2, whose outer columns are empty, copying them out first if
+  // they wrap around the torus.
+  int start = (min - 2 + N) % N;
+  int len = width + 4;
 
-  // if (s == 1)
-  //   s = 0;
+  Word wrapped[N];
+  Word *col = state + start;
+  if (start + len > N) {
+    for (int k = 0; k < len; k++)
+      wrapped[k] = state[(start + k) % N];
+    col = wrapped;
+  }
 
-  // if (e == N - 2)
-  //   e = N - 1;
+  for (int k = 0; k < len; k++) {
+    Word l = RotateLeft(col[k]);
+    Word r = RotateRight(col[k]);
+    tempxor[k] = l ^ r ^ col[k];
+    tempand[k] = ((l ^ r) & col[k]) | (l & r);
+  }
 
-  // for (int i = s; i <= e; i++) {
-  //   state[i] = tempState[i];
-  // }
-  //
+  for (int k = 1; k < len - 1; k++)
+    col[k] = Rokicki(col[k], tempxor[k - 1], tempand[k - 1], tempxor[k + 1], tempand[k + 1]);
+
+  if (col == wrapped) {
+    for (int k = 1; k < len - 1; k++)
+      state[(start + k) % N] = wrapped[k];
+  }
+
+  int first = 1;
+  while (first < len - 1 && col[first] == 0)
+    first++;
+  if (first == len - 1) {
+    SetBounds(0, 0);
+  } else {
+    int last = len - 2;
+    while (col[last] == 0)
+      last--;
+    SetBounds(start + first, last - first + 1);
+  }
 
-  // RecalculateMinMax();
-  min = 0;
-  max = N - 1;
   gen++;
 }
 
-void LifeState::Transform(SymmetryTransform transf) {
+// Several boards stepped together, so that candidate placements can
+// be checked in bulk
+template <int N> class LifeStateBatch {
+public:
+  typedef typename LifeWord<N>::Word Word;
+  typedef typename LifeWord<N>::Columns Columns;
+
+  static const int Lanes = sizeof(Columns) / sizeof(Word);
+
+  Columns state[N];
+
+  // As for LifeState, the columns holding every live cell of every lane
+  int min;
+  int width;
+
+  LifeStateBatch() : min(0), width(0) {
+    for (int i = 0; i < N; i++)
+      state[i] = Columns();
+  }
+
+  // The lane must still be empty
+  void Set(int lane, const LifeState<N> &board) {
+    board.ForEachColumn([&](int i) { SetLane(state[i], lane, board.state[i]); });
+
+    std::pair<int, int> bounds = LifeState<N>::UnionBounds(min, width, board.min, board.BoundsWidth());
+    min = bounds.first;
+    width = bounds.second;
+  }
+
+  bool Equals(int lane, const LifeState<N> &board) const {
+    Word differences = 0;
+    for (int k = 0; k < width; k++) {
+      int i = (min + k) % N;
+      differences |= GetLane(state[i], lane) ^ board.state[i];
+    }
+    board.ForEachColumn([&](int i) { differences |= GetLane(state[i], lane) ^ board.state[i]; });
+    return differences == 0;
+  }
+
+  bool Contains(int lane, const LifeState<N> &pat) const {
+    Word differences = 0;
+    pat.ForEachColumn([&](int i) { differences |= ~GetLane(state[i], lane) & pat.state[i]; });
+    return differences == 0;
+  }
+
+  bool AreDisjoint(int lane, const LifeState<N> &pat) const {
+    Word differences = 0;
+    pat.ForEachColumn([&](int i) { differences |= GetLane(state[i], lane) & pat.state[i]; });
+    return differences == 0;
+  }
+
+  // The same as LifeState::Step on every lane. The bounds only grow,
+  // by a column on each side.
+  void Step() {
+    Columns tempxor[N];
+    Columns tempand[N];
+
+    if (width == 0)
+      return;
+
+    int start = 0;
+    int len = N;
+    bool wraps = width + 4 > N;
+    if (!wraps) {
+      start = min - 2 + N;
+      len = width + 4;
+    }
+
+    for (int k = 0; k < len; k++) {
+      Columns c = state[(start + k) % N];
+      Columns l = RotateLeft(c);
+      Columns r = RotateRight(c);
+      tempxor[k] = l ^ r ^ c;
+      tempand[k] = ((l ^ r) & c) | (l & r);
+    }
+
+    if (wraps) {
+      for (int i = 0; i < N; i++) {
+        int idxU = (i + N - 1) % N;
+        int idxB = (i + 1) % N;
+        state[i] = LifeState<N>::Rokicki(state[i], tempxor[idxU], tempand[idxU],
+                                      tempxor[idxB], tempand[idxB]);
+      }
+      min = 0;
+      width = N;
+    } else {
+      for (int k = 1; k < len - 1; k++) {
+        int i = (start + k) % N;
+        state[i] = LifeState<N>::Rokicki(state[i], tempxor[k - 1], tempand[k - 1],
+                                      tempxor[k + 1], tempand[k + 1]);
+      }
+      min = (min - 1 + N) % N;
+      width += 2;
+    }
+  }
+};
+
+template <int N> void LifeState<N>::Transform(SymmetryTransform transf) {
   switch (transf) {
   case Identity:
     break;
@@ -1174,21 +1642,19 @@ void LifeState::Transform(SymmetryTransform transf) {
     Move(0, 1);
     break;
   }
-  min = 0;
-  max = N - 1;
 }
 
-void LifeState::Print() const {
-  for (int j = 0; j < 64; j++) {
+template <int N> void LifeState<N>::Print() const {
+  for (int j = 0; j < N; j++) {
     for (int i = 0; i < N; i++) {
-      if (GetCell(i - 32, j - 32) == 0) {
+      if (GetCell(i - N / 2, j - N / 2) == 0) {
         int hor = 0;
         int ver = 0;
 
-        if ((j - 32) % 10 == 0)
+        if ((j - N / 2) % 10 == 0)
           hor = 1;
 
-        if ((i - 32) % 10 == 0)
+        if ((i - N / 2) % 10 == 0)
           ver = 1;
 
         if (hor == 1 && ver == 1)
@@ -1208,7 +1674,7 @@ void LifeState::Print() const {
   printf("\n\n\n\n\n\n");
 }
 
-int LifeState::Parse(LifeState &state, const char *rle, int starti) {
+template <int N> int LifeState<N>::Parse(LifeState &state, const char *rle, int starti) {
   char ch;
   int cnt, i, j;
   int x, y;
@@ -1265,78 +1731,38 @@ int LifeState::Parse(LifeState &state, const char *rle, int starti) {
   return -1;
 }
 
-std::string LifeState::RLE() const {
-  std::stringstream result;
-
-  unsigned eol_count = 0;
-
-  for (unsigned j = 0; j < N; j++) {
-    bool last_val = GetCell(0 - 32, j - 32) == 1;
-    unsigned run_count = 0;
-
-    for (unsigned i = 0; i < N; i++) {
-      bool val = GetCell(i - 32, j - 32) == 1;
-
-      // Flush linefeeds if we find a live cell
-      if (val && eol_count > 0) {
-        if (eol_count > 1)
-          result << eol_count;
-
-        result << "$";
-
-        eol_count = 0;
-      }
-
-      // Flush current run if val changes
-      if (val == !last_val) {
-        if (run_count > 1)
-          result << run_count;
-
-        if (last_val == 1)
-          result << "o";
-        else
-          result << "b";
-
-        run_count = 0;
-      }
-
-      run_count++;
-      last_val = val;
-    }
-
-    // Flush run of live cells at end of line
-    if (last_val) {
-      if (run_count > 1)
-        result << run_count;
-
-      result << "o";
-
-      run_count = 0;
-    }
-
-    eol_count++;
-  }
+template <int N> void LifeState<N>::RLERows(Word *rows) const {
+  LifeState<N> transposed = *this;
+  transposed.Transpose(false);
+  for (int j = 0; j < N; j++)
+    rows[j] = RotateRight(transposed.state[(j + N / 2) % N], N / 2);
+}
 
-  // Flush trailing linefeeds
-  if (eol_count > 0) {
-    if (eol_count > 1)
-      result << eol_count;
+template <int N> std::string LifeState<N>::RLE() const {
+  std::string result;
+  RLE(result);
+  return result;
+}
 
-    result << "$";
+template <int N> void LifeState<N>::RLE(std::string &out) const {
+  Word rows[N];
+  RLERows(rows);
 
-    eol_count = 0;
+  RLEWriter writer(out);
+  for (int j = 0; j < N; j++) {
+    writer.Cells(rows[j], N);
+    writer.EndRow();
   }
-
-  return result.str();
+  writer.Finish();
 }
 
-class LifeTarget {
+template <int N> class LifeTarget {
 public:
-  LifeState wanted;
-  LifeState unwanted;
+  LifeState<N> wanted;
+  LifeState<N> unwanted;
 
   LifeTarget() {}
-  LifeTarget(LifeState &state) {
+  LifeTarget(LifeState<N> &state) {
     wanted = state;
     unwanted = state.GetBoundary();
   }
@@ -1348,8 +1774,8 @@ public:
 
   static int Parse(LifeTarget &target, const char *rle, int x, int y,
                    SymmetryTransform transf) {
-    LifeState Temp;
-    int result = LifeState::Parse(Temp, rle, x, y, transf);
+    LifeState<N> Temp;
+    int result = LifeState<N>::Parse(Temp, rle, x, y, transf);
 
     if (result == SUCCESS) {
       target.wanted = Temp;
@@ -1374,16 +1800,253 @@ public:
   static LifeTarget Parse(const char *rle) { return Parse(rle, 0, 0); }
 };
 
-inline bool LifeState::Contains(const LifeTarget &target, int dx,
-                                int dy) const {
+// A small pattern prepared for repeated convolution. The columns of the
+// pattern are grouped by their contents, and each distinct column is
+// split into runs of live cells, so a convolution costs a few shifts
+// per run and one OR per column instead of a pass over the whole torus
+// for every run of the other pattern.
+template <int N> class LifeKernel {
+public:
+  typedef typename LifeWord<N>::Word Word;
+
+  struct Run {
+    unsigned start;
+    unsigned length;
+  };
+
+  struct Part {
+    Word column;
+    std::vector<Run> runs;
+    std::vector<int> offsets;
+  };
+
+  std::vector<Part> parts;
+  int min;
+  int width;
+
+  LifeKernel() : min(0), width(0) {}
+  LifeKernel(const LifeState<N> &state) : min(state.min), width(state.BoundsWidth()) {
+    state.ForEachColumn([&](int i) {
+      Word column = state.state[i];
+      if (column == 0)
+        return;
+
+      for (auto &part : parts) {
+        if (part.column == column) {
+          part.offsets.push_back(i);
+          return;
+        }
+      }
+
+      Part part;
+      part.column = column;
+      part.offsets.push_back(i);
+      if (column == ~(Word)0) {
+        part.runs.push_back({0, N});
+      } else {
+        Word x = column;
+        while (x != 0) {
+          // Find the start of a run, which may wrap around row 0
+          unsigned start;
+          Word shifted;
+          if ((x & 1) == 0) {
+            start = CountTrailingZeros(x);
+            shifted = RotateRight(x, start);
+          } else {
+            unsigned lead = CountLeadingZeros((Word)~x);
+            start = (N - lead) % N;
+            shifted = RotateLeft(x, lead);
+          }
+          unsigned length = CountTrailingZeros((Word)~shifted);
+          part.runs.push_back({start, length});
+          x &= ~RotateLeft(((Word)1 << length) - 1, start);
+        }
+      }
+      parts.push_back(part);
+    });
+  }
+
+};
+
+template <int N>
+LifeState<N> LifeState<N>::Convolve(const LifeKernel<N> &kernel) const {
+  LifeState<N> result;
+  int thisWidth = BoundsWidth();
+  if (thisWidth == 0 || kernel.width == 0)
+    return result;
+
+  // The columns of this in order from min are convolved with one column
+  // of the kernel, and then ORed in at every offset that column occurs.
+  // Each step is a loop over the columns that vectorizes.
+  Word columns[N];
+  for (int t = 0; t < thisWidth; t++)
+    columns[t] = state[(min + t) % N];
+
+  Word spread[N];
+  Word run[N];
+  for (auto &part : kernel.parts) {
+    for (int t = 0; t < thisWidth; t++)
+      spread[t] = 0;
+
+    for (auto &r : part.runs) {
+      // Rotate up by 0 to r.length - 1 rows by doubling
+      SpreadRun(columns, thisWidth, r.length, run);
+      for (int t = 0; t < thisWidth; t++)
+        spread[t] |= RotateLeft(run[t], r.start);
+    }
+
+    for (int offset : part.offsets)
+      result.JoinColumns(spread, (min + offset) % N, thisWidth);
+  }
+
+  result.SetBounds(min + kernel.min, thisWidth + kernel.width - 1);
+  return result;
+}
+
+// Convolve with each of count kernels into the matching results, for
+// many kernels at once. The runs of every length up to SharedRuns are
+// spread once and shared by all the kernels, so each run of a kernel
+// costs one pass over the columns rather than one per doubling.
+template <int N>
+void LifeState<N>::Convolve(const LifeKernel<N> *const *kernels, unsigned count,
+                            LifeState<N> *results) const {
+  for (unsigned k = 0; k < count; k++)
+    results[k] = LifeState<N>();
+  int thisWidth = BoundsWidth();
+  if (thisWidth == 0)
+    return;
+
+  Word columns[N];
+  for (int t = 0; t < thisWidth; t++)
+    columns[t] = state[(min + t) % N];
+
+  const unsigned SharedRuns = 16;
+  unsigned longest = 0;
+  for (unsigned k = 0; k < count; k++)
+    for (auto &part : kernels[k]->parts)
+      for (auto &r : part.runs)
+        longest = std::max(longest, std::min(r.length, SharedRuns));
+
+  // runs[l - 1] is the columns rotated up by 0 to l - 1 rows
+  Word runs[SharedRuns][N];
+  for (int t = 0; t < thisWidth; t++)
+    runs[0][t] = columns[t];
+  for (unsigned l = 1; l < longest; l++)
+    for (int t = 0; t < thisWidth; t++)
+      runs[l][t] = runs[l - 1][t] | RotateLeft(columns[t], l);
+
+  Word spread[N];
+  Word run[N];
+  for (unsigned k = 0; k < count; k++) {
+    const LifeKernel<N> &kernel = *kernels[k];
+    if (kernel.width == 0)
+      continue;
+
+    for (auto &part : kernel.parts) {
+      for (int t = 0; t < thisWidth; t++)
+        spread[t] = 0;
+
+      for (auto &r : part.runs) {
+        const Word *spreadRun = run;
+        if (r.length <= SharedRuns)
+          spreadRun = runs[r.length - 1];
+        else
+          SpreadRun(columns, thisWidth, r.length, run);
+        for (int t = 0; t < thisWidth; t++)
+          spread[t] |= RotateLeft(spreadRun[t], r.start);
+      }
+
+      for (int offset : part.offsets)
+        results[k].JoinColumns(spread, (min + offset) % N, thisWidth);
+    }
+
+    results[k].SetBounds(min + kernel.min, thisWidth + kernel.width - 1);
+  }
+}
+
+// A LifeTarget prepared for matching anywhere on the board: kernels of
+// its live and dead cells rotated by 180 degrees, which is what
+// MatchLiveAndDead convolves with, and of its live cells, for finding
+// the cells a match covers.
+template <int N> class LifeMatcher {
+public:
+  LifeTarget<N> target;
+  LifeKernel<N> live;
+  LifeKernel<N> dead;
+  LifeKernel<N> wanted;
+
+  explicit LifeMatcher(const LifeTarget<N> &targetIn) : target(targetIn) {
+    LifeState<N> flipLive = target.wanted;
+    flipLive.Transform(Rotate180OddBoth);
+    flipLive.RecalculateMinMax();
+    LifeState<N> flipDead = target.unwanted;
+    flipDead.Transform(Rotate180OddBoth);
+    flipDead.RecalculateMinMax();
+    LifeState<N> covered = target.wanted;
+    covered.RecalculateMinMax();
+
+    live = LifeKernel<N>(flipLive);
+    dead = LifeKernel<N>(flipDead);
+    wanted = LifeKernel<N>(covered);
+  }
+};
+
+// The first of the matchers that matches somewhere, with the positions
+// it matches at in matches, or -1. The inverse of the board is only
+// computed once, the live cells of up to MatchBatch matchers are
+// convolved with it in one pass, and the dead cells are only looked at,
+// again in one pass, for the matchers whose live cells fit somewhere.
+template <int N>
+int LifeState<N>::MatchFirst(const std::vector<LifeMatcher<N>> &matchers,
+                             LifeState<N> &matches) const {
+  const unsigned MatchBatch = 8;
+  const LifeKernel<N> *kernels[MatchBatch];
+  LifeState<N> live[MatchBatch];
+  LifeState<N> dead[MatchBatch];
+  unsigned fitting[MatchBatch];
+
+  LifeState<N> inverse = ~*this;
+  for (unsigned first = 0; first < matchers.size(); first += MatchBatch) {
+    unsigned count = std::min(MatchBatch, (unsigned)matchers.size() - first);
+    for (unsigned k = 0; k < count; k++)
+      kernels[k] = &matchers[first + k].live;
+    inverse.Convolve(kernels, count, live);
+
+    unsigned fits = 0;
+    for (unsigned k = 0; k < count; k++) {
+      live[fits] = ~live[k];
+      if (live[fits].IsEmpty())
+        continue;
+      fitting[fits] = first + k;
+      kernels[fits] = &matchers[first + k].dead;
+      fits++;
+    }
+    if (fits == 0)
+      continue;
+
+    Convolve(kernels, fits, dead);
+    for (unsigned k = 0; k < fits; k++) {
+      matches = live[k] & ~dead[k];
+      if (!matches.IsEmpty())
+        return fitting[k];
+    }
+  }
+  return -1;
+}
+
+template <int N>
+inline bool LifeState<N>::Contains(const LifeTarget<N> &target, int dx,
+                                   int dy) const {
   return Contains(target.wanted, dx, dy) &&
          AreDisjoint(target.unwanted, dx, dy);
 }
 
-inline bool LifeState::Contains(const LifeTarget &target) const {
+template <int N>
+inline bool LifeState<N>::Contains(const LifeTarget<N> &target) const {
   return Contains(target.wanted) && AreDisjoint(target.unwanted);
 }
 
-inline LifeState LifeState::Match(const LifeTarget &target) const {
+template <int N>
+inline LifeState<N> LifeState<N>::Match(const LifeTarget<N> &target) const {
   return MatchLiveAndDead(target.wanted, target.unwanted);
 }
@@ -0,0 +1,245 @@
+// Benchmarks for the hot LifeAPI operations. Build and run with
+// `make bench`, or `make bench-scalar` for a build without AVX, and
+// compare the two tables to see what the vector code buys.
+
+#include "../LifeAPI.h"
+
+#include <chrono>
+
+// The catalysts of instrumenting/farm.in
+const char *FarmCatalysts[] = {
+    "2o$2o!",         "2o$o$b3o$3bo!", "bo$obo$obo$bo!",   "b2o$o2bo$bobo$2bo!",
+    "bo$obo$bo!",     "2o$obo$bo!",    "2o$obo$b2o!",      "b2o$o2bo$o2bo$b2o!",
+    "2o$obo$bobo$2bo!"};
+
+// The active pattern of instrumenting/farm.in
+const char *FarmPattern = "2bo$b3o$o3bo$b3o$2bo!";
+
+template <int N> LifeState<N> SparseState(std::mt19937 &rng) {
+  // A small reaction: a random soup in a 16x16 box, run for a while
+  LifeState<N> state;
+  std::uniform_int_distribution<int> coin(0, 1);
+  for (int x = -8; x < 8; x++)
+    for (int y = -8; y < 8; y++)
+      if (coin(rng))
+        state.SetCell(x, y, 1);
+  state.RecalculateMinMax();
+  state.Step(std::uniform_int_distribution<int>(0, 30)(rng));
+  return state;
+}
+
+// A few catalysts scattered around the middle of the board
+template <int N> LifeState<N> CatalystState(std::mt19937 &rng) {
+  const unsigned numCatalysts = sizeof(FarmCatalysts) / sizeof(FarmCatalysts[0]);
+  std::uniform_int_distribution<int> which(0, numCatalysts - 1);
+  std::uniform_int_distribution<int> position(-N / 4, N / 4);
+
+  LifeState<N> state;
+  for (unsigned i = 0; i < 4; i++)
+    state.Join(LifeState<N>::Parse(FarmCatalysts[which(rng)]), position(rng), position(rng));
+  return state;
+}
+
+// A soup filling most of the board, partway through its evolution
+template <int N> LifeState<N> DenseState(std::mt19937 &rng) {
+  LifeState<N> state;
+  std::uniform_int_distribution<int> coin(0, 1);
+  for (int x = -N / 3; x < N / 3; x++)
+    for (int y = -N / 3; y < N / 3; y++)
+      if (coin(rng))
+        state.SetCell(x, y, 1);
+  state.RecalculateMinMax();
+  state.Step(std::uniform_int_distribution<int>(5, 40)(rng));
+  return state;
+}
+
+// The farm.in pattern and a catalyst, at a random generation of the
+// first 100
+template <int N> LifeState<N> FarmState(std::mt19937 &rng) {
+  LifeState<N> state = LifeState<N>::Parse(FarmPattern, 4, 1);
+  state.Join(LifeState<N>::Parse(FarmCatalysts[1]), -2, -10);
+  state.Step(std::uniform_int_distribution<int>(0, 99)(rng));
+  return state;
+}
+
+template <typename F> double TimeLoop(unsigned iterations, F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < iterations; i++)
+    f(i);
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+// Times f over enough iterations to take at least 20ms; finding that
+// many also warms up the caches
+template <typename F> double TimeOp(F f) {
+  unsigned iterations = 256;
+  while (TimeLoop(iterations, f) * iterations < 20e6)
+    iterations *= 2;
+  return TimeLoop(iterations, f);
+}
+
+const char *TransformName(SymmetryTransform transf) {
+  static const char *names[] = {
+      "Identity",         "ReflectAcrossXEven",      "ReflectAcrossX",
+      "ReflectAcrossYEven", "ReflectAcrossY",        "Rotate90Even",
+      "Rotate90",         "Rotate270Even",           "Rotate270",
+      "Rotate180OddBoth", "Rotate180EvenHorizontal", "Rotate180EvenVertical",
+      "Rotate180EvenBoth", "ReflectAcrossYeqX",      "ReflectAcrossYeqNegX",
+      "ReflectAcrossYeqNegXP1"};
+  return names[transf];
+}
+
+uint64_t sink = 0;
+
+// Times f on each sample state in turn; f also gets the sample index
+template <int N, typename F>
+void Bench(const char *input, const std::string &op,
+           const std::vector<LifeState<N>> &states, F f) {
+  double ns = TimeOp([&](unsigned i) {
+    unsigned sample = i % states.size();
+    sink += f(states[sample], sample);
+  });
+  printf("%-4d %-8s %-36s %10.1f\n", N, input, op.c_str(), ns);
+}
+
+template <int N> void BenchInput(const char *input, LifeState<N> (*make)(std::mt19937 &)) {
+  const unsigned samples = 256;
+
+  std::mt19937 rng(1);
+  std::vector<LifeState<N>> states;
+  for (unsigned i = 0; i < samples; i++)
+    states.push_back(make(rng));
+
+  // What the search moves, joins and looks for: a catalyst, its
+  // reaction mask and its target
+  LifeState<N> eater = LifeState<N>::Parse(FarmCatalysts[1]);
+  LifeTarget<N> target(eater);
+  LifeState<N> mask = eater.BigZOI();
+  mask.Transform(Rotate180OddBoth);
+  mask.RecalculateMinMax();
+  LifeKernel<N> kernel(mask);
+  LifeState<N> block = LifeState<N>::Parse(FarmCatalysts[0]);
+
+  // The reaction masks of all the farm catalysts, as TryAddingCatalyst
+  // convolves with them
+  const unsigned numCatalysts = sizeof(FarmCatalysts) / sizeof(FarmCatalysts[0]);
+  std::vector<LifeKernel<N>> kernels;
+  for (unsigned i = 0; i < numCatalysts; i++) {
+    LifeState<N> reactionMask = LifeState<N>::Parse(FarmCatalysts[i]).BigZOI();
+    reactionMask.Transform(Rotate180OddBoth);
+    reactionMask.RecalculateMinMax();
+    kernels.push_back(LifeKernel<N>(reactionMask));
+  }
+  std::vector<const LifeKernel<N> *> kernelList;
+  for (auto &k : kernels)
+    kernelList.push_back(&k);
+  std::vector<LifeState<N>> convolved(numCatalysts);
+
+  std::vector<std::pair<int, int>> offsets;
+  std::uniform_int_distribution<int> position(0, N - 1);
+  for (unsigned i = 0; i < samples; i++)
+    offsets.push_back(std::make_pair(position(rng), position(rng)));
+
+  for (auto &state : states) {
+    if (state.Convolve(mask) != state.Convolve(kernel)) {
+      std::cout << "Convolve mismatch on the " << N << " board" << std::endl;
+      exit(1);
+    }
+    state.Convolve(kernelList.data(), numCatalysts, convolved.data());
+    for (unsigned i = 0; i < numCatalysts; i++) {
+      if (convolved[i] != state.Convolve(kernels[i])) {
+        std::cout << "Multi-kernel Convolve mismatch on the " << N << " board" << std::endl;
+        exit(1);
+      }
+    }
+  }
+
+  Bench<N>(input, "Step", states, [](const LifeState<N> &s, unsigned) {
+    LifeState<N> t = s;
+    t.Step();
+    return t.GetPop();
+  });
+  Bench<N>(input, "Convolve(LifeState)", states,
+           [&](const LifeState<N> &s, unsigned) { return s.Convolve(mask).GetPop(); });
+  Bench<N>(input, "Convolve(LifeKernel)", states,
+           [&](const LifeState<N> &s, unsigned) { return s.Convolve(kernel).GetPop(); });
+  Bench<N>(input, "Convolve(LifeKernel) x9", states, [&](const LifeState<N> &s, unsigned) {
+    unsigned pop = 0;
+    for (auto &k : kernels)
+      pop += s.Convolve(k).GetPop();
+    return pop;
+  });
+  Bench<N>(input, "Convolve(9 LifeKernels)", states, [&](const LifeState<N> &s, unsigned) {
+    s.Convolve(kernelList.data(), numCatalysts, convolved.data());
+    unsigned pop = 0;
+    for (auto &c : convolved)
+      pop += c.GetPop();
+    return pop;
+  });
+  Bench<N>(input, "Match(LifeState)", states,
+           [&](const LifeState<N> &s, unsigned) { return s.Match(block).GetPop(); });
+  Bench<N>(input, "MatchLiveAndDead", states, [&](const LifeState<N> &s, unsigned) {
+    return s.MatchLiveAndDead(target.wanted, target.unwanted).GetPop();
+  });
+  for (int transf = Identity; transf <= ReflectAcrossYeqNegXP1; transf++) {
+    std::string name = std::string("Transform(") + TransformName((SymmetryTransform)transf) + ")";
+    Bench<N>(input, name, states, [&](const LifeState<N> &s, unsigned) {
+      LifeState<N> t = s;
+      t.Transform((SymmetryTransform)transf);
+      return t.GetPop();
+    });
+  }
+  Bench<N>(input, "Join(delta, x, y)", states, [&](const LifeState<N> &s, unsigned i) {
+    LifeState<N> t = s;
+    t.Join(eater, offsets[i].first, offsets[i].second);
+    return t.GetPop();
+  });
+  Bench<N>(input, "Move", states, [&](const LifeState<N> &s, unsigned i) {
+    LifeState<N> t = s;
+    t.Move(offsets[i].first, offsets[i].second);
+    return t.GetPop();
+  });
+  Bench<N>(input, "FirstOn", states,
+           [](const LifeState<N> &s, unsigned) { return s.FirstOn().first; });
+  Bench<N>(input, "Contains(LifeState, x, y)", states, [&](const LifeState<N> &s, unsigned i) {
+    return s.Contains(eater, offsets[i].first, offsets[i].second);
+  });
+  Bench<N>(input, "Contains(LifeTarget, x, y)", states, [&](const LifeState<N> &s, unsigned i) {
+    return s.Contains(target, offsets[i].first, offsets[i].second);
+  });
+  Bench<N>(input, "ComponentContaining", states, [](const LifeState<N> &s, unsigned) {
+    return s.ComponentContaining(s.FirstCell()).GetPop();
+  });
+}
+
+template <int N> void BenchBoard() {
+  BenchInput<N>("sparse", CatalystState<N>);
+  BenchInput<N>("reaction", SparseState<N>);
+  BenchInput<N>("dense", DenseState<N>);
+  BenchInput<N>("farm", FarmState<N>);
+}
+
+int main(int argc, char *argv[]) {
+  // Optionally only one board size, e.g. `LifeBench 64`
+  int only = argc > 1 ? atoi(argv[1]) : 0;
+
+#ifdef __AVX2__
+  const char *isa = "AVX2";
+#else
+  const char *isa = "no AVX2";
+#endif
+  printf("Vector width: %d bytes, %s\n", LIFE_VECTOR_BYTES, isa);
+  printf("%-4s %-8s %-36s %10s\n", "N", "input", "operation", "ns/op");
+
+  if (only == 0 || only == 32)
+    BenchBoard<32>();
+  if (only == 0 || only == 64)
+    BenchBoard<64>();
+  if (only == 0 || only == 128)
+    BenchBoard<128>();
+
+  // Keeps the results live
+  return sink == 42 ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+#!/bin/sh
+# End-to-end benchmark of CatForce, run by `make perf`.
+#
+# Builds the baseline revision PERF_BASE (default HEAD) in a scratch
+# directory, then searches every input of the corpus single-threaded
+# with it and with ./CatForce, PERF_RUNS times each (default 3),
+# alternating between the two so both see the same machine load. For
+# each input the median wall times are compared, and one CSV line is
+# written to bench/perf-results.csv: the median wall time, the number
+# of nodes searched, the peak memory and a checksum of the categorized
+# output.
+#
+# The script fails if any output differs from the baseline revision's
+# or from the checksums in bench/perf-baseline.csv, or if any median
+# wall time is more than PERF_THRESHOLD percent (default 10) above the
+# baseline revision's. Differences under a tenth of a second are timer
+# and scheduling noise on the short inputs, and never fail.
+#
+# `bench/perf.sh --record` (`make perf-baseline`) only runs ./CatForce
+# and writes bench/perf-baseline.csv instead. Set PERF_CORPUS to a list
+# of input files to search those instead of the default corpus.
+
+cd "$(dirname "$0")/.." || exit 1
+repo=$(pwd)
+
+# examples/2.in and examples/p84.in take far longer than the rest put
+# together, so they are left out
+corpus=${PERF_CORPUS:-"examples/1.in examples/3.in examples/4.in examples/match.in
+  examples/orfilter.in examples/p34.in examples/p83.in instrumenting/farm.in
+  bench/perf/biglist-herschel.in bench/perf/biglist-pi.in"}
+threshold=${PERF_THRESHOLD:-10}
+runs=${PERF_RUNS:-3}
+revision=${PERF_BASE:-HEAD}
+baseline=bench/perf-baseline.csv
+results=bench/perf-results.csv
+
+record=
+if [ "$1" = "--record" ]; then
+  record=1
+  results=$baseline
+fi
+
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+if [ -z "$record" ]; then
+  echo "Building $revision to compare against"
+  mkdir "$work/base"
+  if ! git archive "$revision" | tar -x -C "$work/base" ||
+     ! make -C "$work/base" CatForce ${CC:+CC="$CC"} > "$work/base/build.log" 2>&1; then
+    echo "Could not build $revision, see the end of its log:"
+    tail -5 "$work/base/build.log"
+    exit 1
+  fi
+fi
+
+# Searches input with the binary $1 in the directory $2, and sets wall,
+# nodes, peak and checksum
+search() {
+  if ! (cd "$2" && "$1" -j 1 "$name.in" > log 2>&1); then
+    echo "failed, see the end of its log:"
+    tail -5 "$2/log"
+    exit 1
+  fi
+
+  wall=$(sed -n 's/^Total elapsed time: \([0-9.]*\) seconds/\1/p' "$2/log" | tail -1)
+  nodes=$(sed -n 's/^searched: \([0-9]*\) nodes.*/\1/p' "$2/log" | tail -1)
+  peak=$(sed -n 's/^Peak memory: \([0-9]*\) kB/\1/p' "$2/log" | tail -1)
+  checksum=$(cat "$2/out.rle" "$2/full.rle" 2> /dev/null | cksum | cut -d ' ' -f 1)
+}
+
+# The median of the numbers on standard input
+median() {
+  sort -n | awk '{ v[NR] = $1 } END { print NR % 2 ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2 }'
+}
+
+# The checksum column of the baseline for input $1, if there is one
+recorded() {
+  [ -f "$baseline" ] && awk -F, -v input="$1" '
+    NR == 1 { for (i = 1; i <= NF; i++) if ($i == "checksum") c = i; next }
+    $1 == input { print $c }
+  ' "$baseline"
+}
+
+echo "input,wall_seconds,nodes,peak_rss_kb,checksum" > "$results.tmp"
+if [ -z "$record" ]; then
+  printf '%-24s %10s %10s %8s %12s\n' input "base (s)" "new (s)" change nodes
+fi
+
+failed=0
+for input in $corpus; do
+  name=$(basename "$input" .in)
+  for side in new base; do
+    [ -n "$record" ] && [ $side = base ] && continue
+    mkdir -p "$work/$side/$name"
+    # Write the results inside the scratch directory, and don't checkpoint
+    sed -e 's/^output .*/output out.rle/' -e 's/^full-report .*/full-report full.rle/' \
+        -e '/^checkpoint/d' -e '/^threads/d' "$input" > "$work/$side/$name/$name.in"
+    echo "checkpoint none" >> "$work/$side/$name/$name.in"
+  done
+
+  : > "$work/new.times"
+  : > "$work/base.times"
+  i=0
+  while [ $i -lt "$runs" ]; do
+    if [ -z "$record" ]; then
+      search "$work/base/CatForce" "$work/base/$name"
+      echo "$wall" >> "$work/base.times"
+      baseChecksum=$checksum
+    fi
+    search "$repo/CatForce" "$work/new/$name"
+    echo "$wall" >> "$work/new.times"
+    i=$((i + 1))
+  done
+
+  newWall=$(median < "$work/new.times")
+  echo "$name,$newWall,$nodes,$peak,$checksum" >> "$results.tmp"
+
+  if [ -n "$record" ]; then
+    printf '%-24s %8.2fs %12s nodes\n' "$name" "$newWall" "$nodes"
+    continue
+  fi
+
+  baseWall=$(median < "$work/base.times")
+  change=$(awk -v a="$baseWall" -v b="$newWall" 'BEGIN { printf "%+.1f", (a > 0 ? 100 * (b - a) / a : 0) }')
+  expected=$(recorded "$name")
+  status=ok
+  if [ "$checksum" != "$baseChecksum" ]; then
+    status="OUTPUT CHANGED from $revision"
+    failed=1
+  elif [ -n "$expected" ] && [ "$checksum" != "$expected" ]; then
+    status="OUTPUT CHANGED from $baseline"
+    failed=1
+  elif awk -v a="$baseWall" -v b="$newWall" -v c="$change" -v t="$threshold" \
+      'BEGIN { exit !(c > t && b - a >= 0.1) }'; then
+    status=SLOWER
+    failed=1
+  fi
+  printf '%-24s %10.2f %10.2f %7s%% %12s  %s\n' "$name" "$baseWall" "$newWall" "$change" "$nodes" "$status"
+done
+
+mv "$results.tmp" "$results"
+
+if [ -n "$record" ]; then
+  echo "Recorded the baseline in $baseline"
+fi
+exit $failed